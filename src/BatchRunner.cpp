@@ -0,0 +1,92 @@
+#include "BatchRunner.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+BatchRunner::BatchRunner(const std::string& mapPath, uint32_t games, uint32_t threads, uint32_t seed)
+    : _mapPath(mapPath), _games(games), _threads(threads), _seed(seed), _elapsed(0)
+{
+    if (_threads == 0)
+        _threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    _threads = std::min(_threads, std::max(_games, 1u));
+}
+
+bool BatchRunner::Run()
+{
+    GameSettings settings = { true, true, false, false, _seed };
+    _results.assign(_games, { false, false, 0, 0, 0 });
+
+    // report a broken map once instead of from every game, the games share its layout instead of reading the file again
+    Game probe(_mapPath, "", "", settings);
+
+    if (!probe.Init())
+        return false;
+
+    std::shared_ptr<const Map> map = probe.GetMap();
+
+    // games are independent, workers just take the next index
+    std::atomic<uint32_t> next(0);
+    auto work = [&]()
+    {
+        GameSettings settings = { true, true, false, false, 0 };
+        settings.Preloaded = map;
+
+        for (uint32_t i = next++; i < _games; i = next++)
+        {
+            settings.Seed = _seed + i;
+
+            Game game(_mapPath, "", "", settings);
+            game.Init();
+            game.Play();
+            _results[i] = game.GetResult();
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 1; i < _threads; ++i)
+        workers.emplace_back(work);
+
+    work();
+
+    for (auto& worker : workers)
+        worker.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    _elapsed = elapsed.count();
+    return true;
+}
+
+void BatchRunner::PrintReport(std::ostream& os) const
+{
+    uint32_t finished = 0;
+    uint32_t cleared = 0;
+    uint64_t clearTicks = 0;
+    uint64_t livesLost = 0;
+    std::vector<uint32_t> scores;
+
+    for (const GameResult& result : _results)
+    {
+        finished += result.Finished ? 1 : 0;
+        cleared += result.Cleared ? 1 : 0;
+        clearTicks += result.Cleared ? result.Ticks : 0;
+        livesLost += result.LivesLost;
+        scores.push_back(result.Score);
+    }
+
+    std::sort(scores.begin(), scores.end());
+    auto percentile = [&](double p) -> uint32_t { return scores.empty() ? 0 : scores[std::min((size_t)(p / 100.0 * scores.size()), scores.size() - 1)]; };
+
+    os << "Simulated " << _results.size() << " games of " << _mapPath << " on " << _threads << " threads in " << _elapsed << " s (" << _results.size() / _elapsed << " games/s)." << std::endl;
+    os << "=======================================================" << std::endl;
+    os << "Clear rate:\t" << (_results.empty() ? 0.0 : 100.0 * cleared / _results.size()) << " %" << std::endl;
+    os << "Unfinished:\t" << _results.size() - finished << std::endl;
+    os << "Ticks to clear:\t" << (cleared == 0 ? 0.0 : (double)clearTicks / cleared) << " (mean)" << std::endl;
+    os << "Lives lost:\t" << (_results.empty() ? 0.0 : (double)livesLost / _results.size()) << " (mean)" << std::endl;
+    os << "Score:\tmin " << percentile(0) << "\tp10 " << percentile(10) << "\tp25 " << percentile(25) << "\tmedian " << percentile(50)
+       << "\tp75 " << percentile(75) << "\tp90 " << percentile(90) << "\tmax " << (scores.empty() ? 0 : scores.back()) << std::endl;
+}
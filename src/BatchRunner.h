@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Game.h"
+
+#include <ostream>
+
+/**
+ * @brief Class used for evaluating a map by simulating many headless games in parallel.
+*/
+class BatchRunner
+{
+private:
+    std::string _mapPath;
+    uint32_t _games;
+    uint32_t _threads;
+    uint32_t _seed;
+
+    double _elapsed;
+    std::vector<GameResult> _results;
+
+public:
+    /**
+     * @brief Create a new instance of the object.
+     * @param mapPath Map file path.
+     * @param games Number of simulated games.
+     * @param threads Number of worker threads, zero for the number of cores.
+     * @param seed Seed of the first game, every following game uses the next one.
+    */
+    BatchRunner(const std::string& mapPath, uint32_t games, uint32_t threads, uint32_t seed);
+
+    /**
+     * @brief Simulate all games. Results don't depend on the number of threads.
+     * @return False if the game can't be initialized with the map.
+    */
+    bool Run();
+    /**
+     * @brief Print the clear rate, ticks to finish, lives lost and score distribution.
+     * @param os Output stream.
+    */
+    void PrintReport(std::ostream& os) const;
+};
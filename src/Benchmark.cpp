@@ -0,0 +1,350 @@
+#include "GameObjects.h"
+#include "HighscoreLoader.h"
+
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include <unistd.h>
+
+static const uint32_t SEED = 20240601;
+static const int32_t WARMUP = 3;
+static const int32_t SAMPLES = 25;
+static const double SAMPLE_TARGET_NS = 2e6;
+
+/**
+ * @brief Structure used for storing the statistics of a single benchmark.
+*/
+struct Result
+{
+    std::string Name;
+    int64_t Iterations;
+    double Min;
+    double Median;
+    double Mean;
+    double Stddev;
+    double P95;
+};
+
+/**
+ * @brief Keeps the measured results observable so they aren't optimized away.
+*/
+static volatile int64_t sink;
+
+/**
+ * @brief Measure the body. Each sample runs the setup untimed, then the body a calibrated number of times.
+ * @param name Benchmark name.
+ * @param maxIterations Upper bound of body calls per sample, for bodies that change the prepared state.
+ * @param setup Prepares the state for a sample.
+ * @param body Measured operation, receives the index of the call within the sample.
+ * @return Per call statistics in nanoseconds.
+*/
+template <typename Setup, typename Body>
+static Result Measure(const std::string& name, int64_t maxIterations, Setup setup, Body body)
+{
+    auto run = [&](int64_t iterations) -> double
+    {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+
+        for (int64_t i = 0; i < iterations; ++i)
+            body(i);
+
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // grow the sample until it is long enough for the clock resolution
+    int64_t iterations = 1;
+    double elapsed = run(iterations);
+    while (elapsed < SAMPLE_TARGET_NS && iterations < maxIterations)
+    {
+        iterations = std::min(iterations * 2, maxIterations);
+        elapsed = run(iterations);
+    }
+
+    for (int32_t i = 0; i < WARMUP; ++i)
+        run(iterations);
+
+    std::vector<double> samples;
+    for (int32_t i = 0; i < SAMPLES; ++i)
+        samples.push_back(run(iterations) / iterations);
+
+    std::sort(samples.begin(), samples.end());
+
+    double mean = 0;
+    for (double sample : samples)
+        mean += sample;
+    mean /= samples.size();
+
+    double variance = 0;
+    for (double sample : samples)
+        variance += (sample - mean) * (sample - mean);
+    variance /= samples.size() - 1;
+
+    Result result = { name, iterations, samples.front(), samples[samples.size() / 2], mean, std::sqrt(variance), samples[(size_t)std::ceil(0.95 * samples.size()) - 1] };
+    std::cerr << name << "\t" << result.Median << " ns (+- " << result.Stddev << ")" << std::endl;
+    return result;
+}
+
+/**
+ * @brief Generate a finishable map. Walls are isolated so every brick stays reachable.
+ * @param rows Number of rows.
+ * @param columns Number of columns.
+ * @return Map rows in the text format.
+*/
+static std::vector<std::string> GenerateMap(int32_t rows, int32_t columns)
+{
+    Random random(SEED);
+    std::vector<std::string> lines(rows, std::string(columns, '0'));
+
+    for (int32_t i = 0; i < rows; ++i) for (int32_t j = 0; j < columns; ++j)
+    {
+        if (i % 3 == 1 && j % 3 == 1) lines[i][j] = '#';
+        else lines[i][j] = (char)('0' + random.Range(5));
+    }
+
+    lines[0][0] = '1';
+    return lines;
+}
+
+/**
+ * @brief Convert map rows to the layout used by the game objects.
+ * @param lines Map rows in the text format.
+ * @return Map object with the layout.
+*/
+static Map ToMap(const std::vector<std::string>& lines)
+{
+    Map map((int32_t)lines.size(), (int32_t)lines[0].size());
+
+    for (size_t i = 0; i < lines.size(); ++i) for (size_t j = 0; j < lines[i].size(); ++j)
+        map.Set((int32_t)i, (int32_t)j, (int8_t)(lines[i][j] == '#' ? -1 : lines[i][j] - '0'));
+
+    return map;
+}
+
+/**
+ * @brief Write lines to a file.
+ * @param path File path.
+ * @param lines Content.
+*/
+static void WriteLines(const std::string& path, const std::vector<std::string>& lines)
+{
+    std::ofstream ofs(path, std::ios::out | std::ios::trunc);
+
+    for (const std::string& line : lines)
+        ofs << line << "\n";
+
+    if (!ofs)
+        throw std::runtime_error("Failed to write " + path + "!");
+}
+
+/**
+ * @brief Generate a score file in the highscore log format.
+ * @param entries Number of entries.
+ * @param maps Number of distinct maps.
+ * @return Score file lines.
+*/
+static std::vector<std::string> GenerateScores(int32_t entries, int32_t maps)
+{
+    Random random(SEED);
+    std::vector<std::string> lines;
+
+    for (int32_t i = 0; i < entries; ++i)
+        lines.push_back("examples/maps/Map" + std::to_string(random.Range(maps)) + ".txt\t" + std::to_string(random.Range(100000)) + "\t" + std::to_string(random.Range(4)) + "\tPlayer" + std::to_string(random.Range(1000)));
+
+    return lines;
+}
+
+/**
+ * @brief Print the results as JSON.
+ * @param os Output stream.
+ * @param results Benchmark results.
+*/
+static void PrintJson(std::ostream& os, const std::vector<Result>& results)
+{
+    os << "{" << std::endl;
+    os << "  \"context\": { \"compiler\": \"" << __VERSION__ << "\", \"seed\": " << SEED << ", \"warmup\": " << WARMUP << ", \"samples\": " << SAMPLES << ", \"unit\": \"ns\" }," << std::endl;
+    os << "  \"benchmarks\": [" << std::endl;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& r = results[i];
+        os << "    { \"name\": \"" << r.Name << "\", \"iterations\": " << r.Iterations << ", \"min\": " << r.Min << ", \"median\": " << r.Median
+           << ", \"mean\": " << r.Mean << ", \"stddev\": " << r.Stddev << ", \"p95\": " << r.P95 << " }" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+
+    os << "  ]" << std::endl;
+    os << "}" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 2)
+    {
+        std::cout << "Usage: " << argv[0] << " [output json]" << std::endl;
+        return 1;
+    }
+
+    char directory[] = "/tmp/pupaldom-bench-XXXXXX";
+    if (mkdtemp(directory) == nullptr)
+    {
+        std::cout << "Failed to create a directory for the generated data!" << std::endl;
+        return 1;
+    }
+
+    bool failed = false;
+    std::vector<Result> results;
+    std::vector<std::string> files;
+
+    try
+    {
+        // maps - legacy size and synthetic large ones
+        const std::pair<int32_t, int32_t> sizes[] = { { 10, 8 }, { 256, 256 }, { 1024, 1024 } };
+
+        for (const auto& size : sizes)
+        {
+            std::string suffix = std::to_string(size.first) + "x" + std::to_string(size.second);
+            std::string path = std::string(directory) + "/Map" + suffix + ".txt";
+            std::vector<std::string> lines = GenerateMap(size.first, size.second);
+            Map map = ToMap(lines);
+
+            WriteLines(path, lines);
+            files.push_back(path);
+            files.push_back(MapLoader::GetCompiledPath(path));
+
+            // first load parses the text and writes the compiled map, the following ones use it
+            results.push_back(Measure("MapLoader::Load/text/" + suffix, 1, [&] { unlink(MapLoader::GetCompiledPath(path).c_str()); }, [&](int64_t)
+                {
+                    MapLoader loader(path, size.first, size.second);
+                    sink = loader.Load().GetRows();
+                }));
+
+            results.push_back(Measure("MapLoader::Load/compiled/" + suffix, INT64_MAX, [] { }, [&](int64_t)
+                {
+                    MapLoader loader(path, size.first, size.second);
+                    sink = loader.Load().GetRows();
+                }));
+
+            results.push_back(Measure("MapLoader::IsValid/" + suffix, INT64_MAX, [] { }, [&](int64_t)
+                {
+                    sink = MapLoader::IsValid(map);
+                }));
+
+            // ball positions spread over the grid, moving up and right
+            BrickManager bricks({ 0, 0, 0, 0 }, 0, map, 0, 0, 64, 24);
+            Random random(SEED);
+            std::vector<Ball> balls;
+
+            for (int32_t i = 0; i < 64; ++i)
+            {
+                Ball ball(0, random.Range(size.second * 64), random.Range(size.first * 24), 12, 12, 8);
+                ball.Start(random);
+                ball.Reflect(ball.GetDirectionX() < 0, false);
+                balls.push_back(ball);
+            }
+
+            results.push_back(Measure("BrickManager::CollisionBall/" + suffix, INT64_MAX, [] { }, [&](int64_t i)
+                {
+                    sink = bricks.CollisionBall(balls[i % balls.size()], 8).Step;
+                }));
+        }
+
+        // validation alone on a huge generated map
+        {
+            Map map = ToMap(GenerateMap(4096, 4096));
+
+            results.push_back(Measure("MapLoader::IsValid/4096x4096", INT64_MAX, [] { }, [&](int64_t)
+                {
+                    sink = MapLoader::IsValid(map);
+                }));
+        }
+
+        // bonuses - falling far from the platform, nothing gets caught or leaves the screen, the largest count fills the pool
+        const int32_t counts[] = { 16, 256, 1024 };
+
+        for (int32_t count : counts)
+        {
+            Random random(SEED);
+            BonusManager bonuses({ 0, 0, 0, 0, 0, 0 }, 24, 24, 100, 1000, random);
+            Player player(0, 100000, 661, 64, 16, 128, 4);
+            Ball ball(0, 0, 0, 12, 12, 8);
+            ScoreCounter score;
+
+            results.push_back(Measure("BonusManager::CollisionPlayer/" + std::to_string(count), 128, [&]
+                {
+                    random = Random(SEED);
+                    bonuses.Clear();
+
+                    for (int32_t i = 0; i < count; ++i)
+                        bonuses.Generate(random.Range(500), -random.Range(500));
+                }, [&](int64_t)
+                {
+                    bonuses.CollisionPlayer(player, ball, score);
+                }));
+        }
+
+        // ball against a single object - hit, miss and graze
+        {
+            GameObject target(0, 100, 100, 64, 24);
+            Random random(SEED);
+            std::vector<Ball> balls;
+
+            const std::pair<int32_t, int32_t> positions[] = { { 120, 130 }, { 300, 300 }, { 160, 126 } };
+            for (const auto& position : positions)
+            {
+                Ball ball(0, position.first, position.second, 12, 12, 8);
+                ball.Start(random);
+                ball.Reflect(ball.GetDirectionX() < 0, false);
+                balls.push_back(ball);
+            }
+
+            results.push_back(Measure("Ball::CollisionCheck", INT64_MAX, [] { }, [&](int64_t i)
+                {
+                    sink = balls[i % balls.size()].CollisionCheck(target, 8).Step;
+                }));
+        }
+
+        // highscores - multi-megabyte log
+        const int32_t entries[] = { 1000, 100000 };
+
+        for (int32_t count : entries)
+        {
+            std::string path = std::string(directory) + "/Score" + std::to_string(count) + ".txt";
+            WriteLines(path, GenerateScores(count, 10));
+            files.push_back(path);
+            files.push_back(HighscoreLoader(path).GetIndexPath());
+
+            // first load merges the whole score file into the index, the following ones read only the index
+            results.push_back(Measure("HighscoreLoader::Load/rebuild/" + std::to_string(count), 1, [&] { unlink(HighscoreLoader(path).GetIndexPath().c_str()); }, [&](int64_t)
+                {
+                    HighscoreLoader loader(path);
+                    loader.Load("examples/maps/Map0.txt");
+                }));
+
+            results.push_back(Measure("HighscoreLoader::Load/indexed/" + std::to_string(count), INT64_MAX, [] { }, [&](int64_t)
+                {
+                    HighscoreLoader loader(path);
+                    loader.Load("examples/maps/Map0.txt");
+                    sink = loader.GetHighscores().size();
+                }));
+        }
+    }
+    catch (const MapLoaderException& e) { std::cout << e.Message() << std::endl; failed = true; }
+    catch (const HighscoreLoaderException& e) { std::cout << e.Message() << std::endl; failed = true; }
+    catch (const std::runtime_error& e) { std::cout << e.what() << std::endl; failed = true; }
+
+    for (const std::string& file : files)
+        unlink(file.c_str());
+    rmdir(directory);
+
+    if (argc == 2)
+    {
+        std::ofstream ofs(argv[1], std::ios::out | std::ios::trunc);
+        PrintJson(ofs, results);
+    }
+    else PrintJson(std::cout, results);
+
+    return failed ? 1 : 0;
+}
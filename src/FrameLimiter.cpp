@@ -3,15 +3,37 @@
 #include <SDL2/SDL.h>
 
 FrameLimiter::FrameLimiter(uint32_t targetFPS)
-    : _tick(0), _elapsed(0), _targeted(1000 / targetFPS) { }
+    : _start(0), _frequency(SDL_GetPerformanceFrequency()), _period(0), _targeted(0)
+{
+    SetTarget(targetFPS);
+}
+
+void FrameLimiter::SetTarget(uint32_t targetFPS)
+{
+    _targeted = targetFPS;
+    _period = targetFPS != 0 ? _frequency / targetFPS : 0;
+}
+
+uint32_t FrameLimiter::GetTarget() const
+{
+    return _targeted;
+}
 
 void FrameLimiter::Start()
 {
-    _tick = SDL_GetTicks();
+    _start = SDL_GetPerformanceCounter();
 }
 
 void FrameLimiter::End()
 {
-    if (_targeted > (_elapsed = SDL_GetTicks() - _tick))
-        SDL_Delay(_targeted - _elapsed);
+    if (_period == 0)
+        return;
+
+    uint64_t elapsed = SDL_GetPerformanceCounter() - _start;
+
+    // the sleep can overshoot, the last millisecond is spun
+    if (elapsed + 2 * _frequency / 1000 < _period)
+        SDL_Delay((uint32_t)((_period - elapsed) * 1000 / _frequency) - 1);
+
+    while (SDL_GetPerformanceCounter() - _start < _period) { }
 }
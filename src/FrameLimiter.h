@@ -8,22 +8,33 @@
 class FrameLimiter
 {
 private:
-    uint32_t _tick;
-    uint32_t _elapsed;
-    const uint32_t _targeted;
+    uint64_t _start;
+    uint64_t _frequency;
+    uint64_t _period; // performance counter ticks per frame, 0 if unlimited
+    uint32_t _targeted;
 
 public:
     /**
      * @brief Create a new instance of the object.
-     * @param targetFPS Desired framerate.
+     * @param targetFPS Desired framerate, 0 for no limit.
     */
     FrameLimiter(uint32_t targetFPS);
+    /**
+     * @brief Change the desired framerate.
+     * @param targetFPS Desired framerate, 0 for no limit.
+    */
+    void SetTarget(uint32_t targetFPS);
+    /**
+     * @brief Desired framerate getter.
+     * @return Value of the desired framerate, 0 if unlimited.
+    */
+    uint32_t GetTarget() const;
     /**
      * @brief Set the start of the frame.
     */
     void Start();
     /**
-     * @brief Set the end of the frame. Delay in case of exceeding framerate.
+     * @brief Set the end of the frame. Delay in case of exceeding framerate, whole milliseconds are slept and the rest is spun.
     */
     void End();
 };
@@ -1,43 +1,93 @@
+#include <chrono>
+#include <algorithm>
 #include <iostream>
 
 #include "Game.h"
 
-Game::Game(const std::string& mapPath, const std::string& scorePath, const std::string& playerName)
-    : _appState(AppState::DEFAULT), _gameState(GameState::IDLE), _maper(mapPath, BRICK_ROWS, BRICK_COLUMNS), _framer(WINDOW_FPS), _scorer(scorePath), _playerName(playerName) { }
+Game::Game(const std::string& mapPath, const std::string& scorePath, const std::string& playerName, const GameSettings& settings)
+    : _appState(AppState::DEFAULT), _gameState(GameState::IDLE), _maper(mapPath, BRICK_ROWS, BRICK_COLUMNS), _framer(WINDOW_FPS), _scorer(scorePath), _playerName(playerName), _settings(settings), _ticks(0),
+    _seed(settings.Playback ? settings.Playback->GetSeed() : settings.Seed), _random(_seed), _aim(0), _result({ false, false, 0, 0, 0 }), _profiler(settings.Profile), _tracer(settings.Latency && !settings.Headless && !settings.Playback), _recording(_seed, mapPath), _fieldWidth(WINDOW_WIDTH), _fieldHeight(WINDOW_HEIGHT) { }
 
-void Game::Init()
+bool Game::Init()
 {
     try
     {
-        // load map
-        Map map = _maper.Load();
+        // load map unless it is shared by the caller
+        _map = _settings.Preloaded ? _settings.Preloaded : std::make_shared<const Map>(_maper.Load());
 
         // initialize renderer
-        _renderer.Init("Resonating Voidness", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH, WINDOW_HEIGHT, false, { 0, 0, 0, 255 });
-
-        // initialize textures
-        std::shared_ptr<Texture> nebula1 = TextureLoader::Load("assets/Nebula1.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> nebula2 = TextureLoader::Load("assets/Nebula2.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> nebula3 = TextureLoader::Load("assets/Nebula3.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> stars = TextureLoader::Load("assets/Stars.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> frame = TextureLoader::Load("assets/Frame.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> ball = TextureLoader::Load("assets/Ball.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> platform = TextureLoader::Load("assets/Platform.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> brickYellow = TextureLoader::Load("assets/BrickYellow.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> brickGreen = TextureLoader::Load("assets/BrickGreen.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> brickBlue = TextureLoader::Load("assets/BrickBlue.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> brickGray = TextureLoader::Load("assets/BrickGray.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> brickRed = TextureLoader::Load("assets/BrickRed.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> bonusGreen = TextureLoader::Load("assets/BonusGreen.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> bonusBlue = TextureLoader::Load("assets/BonusBlue.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> bonusRed = TextureLoader::Load("assets/BonusRed.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> bonusTeal = TextureLoader::Load("assets/BonusTeal.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> bonusYellow = TextureLoader::Load("assets/BonusYellow.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> bonusPurple = TextureLoader::Load("assets/BonusPurple.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> healthLabel = TextureLoader::Load("assets/LivesLabel.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> endScreen = TextureLoader::Load("assets/EndScreen.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> winLabel = TextureLoader::Load("assets/WinLabel.png", _renderer.GetRenderer());
-        std::shared_ptr<Texture> loseLabel = TextureLoader::Load("assets/LoseLabel.png", _renderer.GetRenderer());
+        if (_settings.Headless) _renderer.InitHeadless();
+        else _renderer.Init("Resonating Voidness", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH, WINDOW_HEIGHT, false, { 0, 0, 0, 255 }, _settings.Render);
+
+        // vsync paces the frames on its own unless a lower frame rate is asked for
+        _framer.SetTarget(_settings.Uncapped ? 0 : _settings.Fps != 0 ? _settings.Fps : _renderer.IsVsync() ? 0 : WINDOW_FPS);
+
+        // initialize textures - prebaked pack if available, anything missing is decoded in parallel, all sprites share a few atlas pages
+        _loader.LoadPack("assets/Assets.pack", _renderer.GetRenderer());
+
+        std::vector<std::shared_ptr<Texture>> loaded = _loader.LoadAtlas(
+            {
+                "assets/Nebula1.png",
+                "assets/Nebula2.png",
+                "assets/Nebula3.png",
+                "assets/Stars.png",
+                "assets/Frame.png",
+                "assets/Ball.png",
+                "assets/Platform.png",
+                "assets/BrickYellow.png",
+                "assets/BrickGreen.png",
+                "assets/BrickBlue.png",
+                "assets/BrickGray.png",
+                "assets/BrickRed.png",
+                "assets/BonusGreen.png",
+                "assets/BonusBlue.png",
+                "assets/BonusRed.png",
+                "assets/BonusTeal.png",
+                "assets/BonusYellow.png",
+                "assets/BonusPurple.png",
+                "assets/LivesLabel.png",
+                "assets/EndScreen.png",
+                "assets/WinLabel.png",
+                "assets/LoseLabel.png"
+            }, _renderer.GetRenderer());
+
+        // objects refer to the textures by handles resolved by the renderer
+        std::vector<TextureHandle> sprites;
+        for (const std::shared_ptr<Texture>& texture : loaded)
+            sprites.push_back(_renderer.Register(texture));
+
+        TextureHandle nebula1 = sprites[0];
+        TextureHandle nebula2 = sprites[1];
+        TextureHandle nebula3 = sprites[2];
+        TextureHandle stars = sprites[3];
+        TextureHandle frame = sprites[4];
+        TextureHandle ball = sprites[5];
+        TextureHandle platform = sprites[6];
+        TextureHandle brickYellow = sprites[7];
+        TextureHandle brickGreen = sprites[8];
+        TextureHandle brickBlue = sprites[9];
+        TextureHandle brickGray = sprites[10];
+        TextureHandle brickRed = sprites[11];
+        TextureHandle bonusGreen = sprites[12];
+        TextureHandle bonusBlue = sprites[13];
+        TextureHandle bonusRed = sprites[14];
+        TextureHandle bonusTeal = sprites[15];
+        TextureHandle bonusYellow = sprites[16];
+        TextureHandle bonusPurple = sprites[17];
+        TextureHandle healthLabel = sprites[18];
+        TextureHandle endScreen = sprites[19];
+        TextureHandle winLabel = sprites[20];
+        TextureHandle loseLabel = sprites[21];
+
+        // field is the window unless the map doesn't fit, bricks are centered horizontally
+        int32_t bricksWidth = _map->GetColumns() * BRICK_WIDTH;
+        int32_t bricksHeight = _map->GetRows() * BRICK_HEIGHT;
+        int32_t bricksX = FRAME_BRICK_OFFSET;
+        int32_t bricksY = FRAME_BRICK_OFFSET - FRAME_WIDTH_OFFSET + FRAME_HEIGHT_OFFSET;
+
+        _fieldWidth = std::max(bricksWidth + 2 * bricksX, _fieldWidth);
+        _fieldHeight = std::max(bricksHeight + _fieldHeight - (int32_t)BRICK_ROWS * BRICK_HEIGHT, _fieldHeight);
+        bricksX = (_fieldWidth - bricksWidth) / 2;
 
         // initialize objects
         _background = std::make_shared<Background>(Background(
@@ -59,55 +109,159 @@ void Game::Init()
                 GameObject(loseLabel, 0, 0, 580, 720).Clone()
             }));
         _lives = std::make_shared<Health>(Health(ball, healthLabel, INITIAL_LIVES, FRAME_BRICK_OFFSET, WINDOW_HEIGHT - 40, 95, 40, 24, 24));
-        _ball = std::make_shared<Ball>(Ball(ball, WINDOW_WIDTH / 2 - 24 / 4, WINDOW_HEIGHT - 120, 24 / 2, 24 / 2, INITIAL_SPEED_BALL));
-        _player = std::make_shared<Player>(Player(platform, WINDOW_WIDTH / 2 - 128 / 4, WINDOW_HEIGHT - 59, 128 / 2, 32 / 2, 128, INITIAL_SPEED_PLAYER));
-        _bricks = std::make_shared<BrickManager>(BrickManager({ brickGreen, brickYellow, brickBlue, brickRed }, brickGray, map, FRAME_BRICK_OFFSET, FRAME_BRICK_OFFSET - FRAME_WIDTH_OFFSET + FRAME_HEIGHT_OFFSET, 64, 24));
-        _bonuses = std::make_shared<BonusManager>(BonusManager({ bonusBlue, bonusGreen, bonusRed, bonusTeal, bonusYellow, bonusPurple }, 24, 24, INITIAL_BONUS_PROPABILITY));
+        _ball = std::make_shared<Ball>(Ball(ball, _fieldWidth / 2 - 24 / 4, _fieldHeight - 120, 24 / 2, 24 / 2, INITIAL_SPEED_BALL));
+        _player = std::make_shared<Player>(Player(platform, _fieldWidth / 2 - 128 / 4, _fieldHeight - 59, 128 / 2, 32 / 2, 128, INITIAL_SPEED_PLAYER));
+        _bricks = std::make_shared<BrickManager>(BrickManager({ brickGreen, brickYellow, brickBlue, brickRed }, brickGray, *_map, bricksX, bricksY, BRICK_WIDTH, BRICK_HEIGHT));
+        _bonuses = std::make_shared<BonusManager>(BonusManager({ bonusBlue, bonusGreen, bonusRed, bonusTeal, bonusYellow, bonusPurple }, 24, 24, INITIAL_BONUS_PROPABILITY, _fieldHeight, _random));
 
-        // set context
-        _drawContext = { _background, _lives, _player, _ball, _bricks, _bonuses };
+        // set context - rarely changing objects are cached in layers
+        _backgroundContext = { std::make_shared<Layer>(Layer(_background, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, true)) };
+        _overlayContext = { std::make_shared<Layer>(Layer(_lives, FRAME_BRICK_OFFSET, WINDOW_HEIGHT - 40, 95 + INITIAL_LIVES * (24 + 5), 40, false)) };
+        _drawContext =
+        {
+            _player,
+            _ball,
+            bricksWidth <= BRICK_LAYER_MAX_SIZE && bricksHeight <= BRICK_LAYER_MAX_SIZE ? std::make_shared<Layer>(Layer(_bricks, bricksX, bricksY, bricksWidth, bricksHeight, false)) : std::shared_ptr<IDrawable>(_bricks),
+            _bonuses
+        };
         _appState = AppState::RUNNING;
     }
     catch (const RenderManagerException& e) { std::cout << e.Message() << std::endl; }
     catch (const TextureLoaderException& e) { std::cout << e.Message() << std::endl; }
     catch (const MapLoaderException& e) { std::cout << e.Message() << std::endl; }
+
+    return _appState == AppState::RUNNING;
 }
 
 void Game::Play()
 {
-    while (_appState == AppState::RUNNING)
+    if (_appState != AppState::RUNNING)
+        return;
+
+    if (_settings.Headless || _settings.Playback)
+    {
+        // run as fast as possible
+        auto start = std::chrono::steady_clock::now();
+
+        while (_appState == AppState::RUNNING)
+        {
+            _profiler.BeginFrame();
+            ScopedTimer timer(_profiler, Profiler::FRAME);
+
+            Update(SDL_GetTicks());
+            Draw(1.0f);
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (!_settings.Silent) std::cout << "Simulated " << _ticks << " ticks in " << elapsed.count() << " s (" << _ticks / elapsed.count() << " ticks/s)." << std::endl;
+    }
+    else
     {
-        _framer.Start();
+        // fixed timestep - the simulation runs at the tick rate regardless of the render rate
+        const uint64_t frequency = SDL_GetPerformanceFrequency();
+        const uint64_t tick = frequency / TICK_RATE;
+        uint64_t previous = SDL_GetPerformanceCounter();
+        uint64_t accumulator = 0;
+
+        while (_appState == AppState::RUNNING)
+        {
+            _framer.Start();
+            _profiler.BeginFrame();
+
+            {
+                // frame time excludes the limiter wait
+                ScopedTimer timer(_profiler, Profiler::FRAME);
+
+                uint64_t now = SDL_GetPerformanceCounter();
+                uint32_t time = SDL_GetTicks();
+                accumulator = std::min(accumulator + now - previous, tick * MAX_FRAME_TICKS); // don't spiral after a long stall
+                previous = now;
 
-        Update();
-        Draw();
+                // the simulation lags behind the event time by what is left in the accumulator after the tick
+                for (; accumulator >= tick && _appState == AppState::RUNNING; accumulator -= tick)
+                    Update(time - (uint32_t)((accumulator - tick) * 1000 / frequency));
 
-        _framer.End();
+                Draw((float)accumulator / tick);
+            }
+
+            _framer.End();
+        }
     }
+
+    ReportHighscores(true);
+    ReportProfile();
+    ReportLatency();
+    FinishReplay();
 }
 
-void Game::Draw()
+GameResult Game::GetResult() const
 {
-    _renderer.Clear();
+    if (_result.Finished)
+        return _result;
+
+    return { false, false, _ticks, INITIAL_LIVES - _lives->GetHealth(), _counter.GetScore() };
+}
 
-    for (size_t i = 0; i < _drawContext.size(); ++i)
-        _drawContext[i]->Draw(_renderer);
+std::shared_ptr<const Map> Game::GetMap() const
+{
+    return _map;
+}
 
+void Game::Draw(float alpha)
+{
+    {
+        ScopedTimer timer(_profiler, Profiler::DRAW);
+
+        _renderer.Clear();
+
+        for (size_t i = 0; i < _backgroundContext.size(); ++i)
+            _backgroundContext[i]->Draw(_renderer, alpha);
+
+        // the field scrolls inside the frame
+        const SDL_Rect inner = { FRAME_WIDTH_OFFSET, FRAME_HEIGHT_OFFSET, WINDOW_WIDTH - 2 * FRAME_WIDTH_OFFSET, WINDOW_HEIGHT - FRAME_HEIGHT_OFFSET };
+        SDL_Point camera = GetCamera(alpha);
+
+        _renderer.SetClip(&inner);
+        _renderer.SetCamera(camera.x, camera.y);
+
+        for (size_t i = 0; i < _drawContext.size(); ++i)
+            _drawContext[i]->Draw(_renderer, alpha);
+
+        _renderer.SetCamera(0, 0);
+        _renderer.SetClip(nullptr);
+
+        for (size_t i = 0; i < _overlayContext.size(); ++i)
+            _overlayContext[i]->Draw(_renderer, alpha);
+
+        _profiler.Draw(_renderer, FRAME_BRICK_OFFSET, FRAME_BRICK_OFFSET, 1000.0 / (_framer.GetTarget() != 0 ? _framer.GetTarget() : WINDOW_FPS));
+    }
+
+    ScopedTimer timer(_profiler, Profiler::PRESENT);
     _renderer.Present();
+    _tracer.Present();
 }
 
-void Game::Update()
+void Game::Update(uint32_t time)
 {
-    ProcessEvents();
+    ScopedTimer timer(_profiler, Profiler::UPDATE);
+    ++_ticks;
+
+    if (_gameState == GameState::STOP)
+        ReportHighscores(false);
+
+    _player->SavePosition();
+    _ball->SavePosition();
+
+    ProcessEvents(time);
 
     // check boundary for moving objects
-    _player->CollisionBoundary(FRAME_WIDTH_OFFSET, WINDOW_WIDTH - FRAME_WIDTH_OFFSET);
-    _ball->CollisionBoundary(FRAME_WIDTH_OFFSET, FRAME_HEIGHT_OFFSET, WINDOW_WIDTH - FRAME_WIDTH_OFFSET);
+    _player->CollisionBoundary(FRAME_WIDTH_OFFSET, _fieldWidth - FRAME_WIDTH_OFFSET);
+    _tracer.Update();
 
     // ball position
     if (_gameState == GameState::PLAY)
     {
-        if (_ball->IsUnder(WINDOW_HEIGHT))
+        if (_ball->IsUnder(_fieldHeight))
         {
             _lives->DecreaseHealth();
 
@@ -119,11 +273,14 @@ void Game::Update()
             return;
         }
 
-        if (_ball->CollisionCheck(_player))
-            _counter.ResetMultiplier();
-
-        _bonuses->CollisionPlayer(*_player, *_ball, _counter);
-        _bricks->CollisionBall(*_ball, *_bonuses, _counter);
+        {
+            ScopedTimer timer(_profiler, Profiler::COLLISION_BONUSES);
+            _bonuses->CollisionPlayer(*_player, *_ball, _counter);
+        }
+        {
+            ScopedTimer timer(_profiler, Profiler::COLLISION_BALL);
+            MoveBall();
+        }
 
         if (_bricks->IsFinished())
         {
@@ -133,8 +290,6 @@ void Game::Update()
             _bonuses->Clear();
             return;
         }
-
-        _ball->Update();
     }
     else if (_gameState == GameState::IDLE)
     {
@@ -142,9 +297,76 @@ void Game::Update()
     }
 }
 
-void Game::ProcessEvents()
+SDL_Point Game::GetCamera(float alpha) const
+{
+    SDL_Point ball = _ball->GetPosition(alpha);
+    int32_t x = std::min(std::max(ball.x + _ball->GetWidth() / 2 - (int32_t)WINDOW_WIDTH / 2, 0), _fieldWidth - (int32_t)WINDOW_WIDTH);
+    int32_t y = std::min(std::max(ball.y + _ball->GetHeight() / 2 - (int32_t)WINDOW_HEIGHT / 2, 0), _fieldHeight - (int32_t)WINDOW_HEIGHT);
+
+    return { x, y };
+}
+
+void Game::MoveBall()
+{
+    int32_t steps = _ball->GetSpeed();
+
+    for (int32_t i = 0; i < MAX_BALL_CONTACTS; ++i)
+    {
+        Contact boundary = _ball->CollisionBoundary(FRAME_WIDTH_OFFSET, FRAME_HEIGHT_OFFSET, _fieldWidth - FRAME_WIDTH_OFFSET, steps);
+        Contact platform = _ball->CollisionCheck(*_player, steps);
+        Contact bricks = _bricks->CollisionBall(*_ball, steps);
+        Contact contact = Contact::Earliest(boundary, Contact::Earliest(platform, bricks));
+
+        if (contact.Step < 0)
+        {
+            _ball->Advance(steps);
+            return;
+        }
+
+        if (platform.Step == contact.Step)
+            _counter.ResetMultiplier();
+
+        if (bricks.Step == contact.Step)
+            _bricks->Hit(*_ball, contact.Step, *_bonuses, _counter);
+
+        _ball->Advance(contact.Step);
+        _ball->Reflect(contact.FlipX, contact.FlipY);
+        steps -= contact.Step;
+    }
+
+    // too many contacts in a single tick - the rest of the movement is dropped rather than risking a tunnel
+}
+
+void Game::ProcessEvents(uint32_t time)
 {
-    _input.Process();
+    ScopedTimer timer(_profiler, Profiler::PROCESS_EVENTS);
+
+    if (!_settings.Headless)
+    {
+        _input.Process();
+        _input.Advance(time);
+    }
+
+    // window close is recorded as escape so the playback quits on the same tick
+    if (_input.State == InputHandler::State::QUIT)
+        _input.KeyMap[InputHandler::KEY_ESCAPE] = true;
+
+    if (_settings.Playback)
+    {
+        if (!_settings.Playback->Next(_input))
+            _input.KeyMap[InputHandler::KEY_ESCAPE] = true;
+    }
+    else if (_settings.Headless) Autopilot();
+
+    if (!_settings.RecordPath.empty())
+        _recording.Record(_input);
+
+    // cached layers have to be redrawn after device reset
+    if (_input.TargetsReset)
+    {
+        _renderer.InvalidateTargets();
+        _input.TargetsReset = false;
+    }
 
     // handle quit event
     if (_input.State == InputHandler::State::QUIT || _input.KeyMap[InputHandler::KEY_ESCAPE])
@@ -157,31 +379,111 @@ void Game::ProcessEvents()
     if (_gameState == GameState::IDLE && _input.KeyMap[InputHandler::KEY_SPACE])
     {
         _gameState = GameState::PLAY;
-        _ball->Start();
+        _ball->Start(_random);
     }
 
-    if (_gameState != GameState::STOP && _input.KeyMap[InputHandler::KEY_LEFT_ARROW] && !_input.KeyMap[InputHandler::KEY_RIGHT_ARROW])
-        _player->Move(true);
+    // opposite keys cancel out for the time both are held
+    if (_gameState != GameState::STOP)
+    {
+        _player->Move(_input.Held[InputHandler::KEY_RIGHT_ARROW] - _input.Held[InputHandler::KEY_LEFT_ARROW], InputHandler::HELD_STEPS);
+        _tracer.Process(_input.Applied);
+    }
+}
+
+void Game::Autopilot()
+{
+    // hit the ball off-center by up to a quarter of the platform
+    if (_gameState == GameState::IDLE)
+        _aim = _random.Range(_player->GetWidth() / 2 + 1) - _player->GetWidth() / 4;
+
+    int32_t target = _ball->GetX() + _ball->GetWidth() / 2 + _aim;
+    int32_t center = _player->GetX() + _player->GetWidth() / 2;
 
-    if (_gameState != GameState::STOP && _input.KeyMap[InputHandler::KEY_RIGHT_ARROW] && !_input.KeyMap[InputHandler::KEY_LEFT_ARROW])
-        _player->Move(false);
+    _input.Set(InputHandler::KEY_SPACE, _gameState == GameState::IDLE);
+    _input.Set(InputHandler::KEY_ESCAPE, _gameState == GameState::STOP || _ticks >= HEADLESS_TICK_LIMIT);
+    _input.Set(InputHandler::KEY_LEFT_ARROW, target < center - AUTOPILOT_DEADZONE);
+    _input.Set(InputHandler::KEY_RIGHT_ARROW, target > center + AUTOPILOT_DEADZONE);
 }
 
 void Game::EndGame(bool win)
 {
     _gameState = GameState::STOP;
-    _drawContext.push_back(win ? _winScreen : _loseScreen);
+    _result = { true, win, _ticks, INITIAL_LIVES - _lives->GetHealth(), _counter.GetScore() };
+    _overlayContext.push_back(std::make_shared<Layer>(Layer(win ? _winScreen : _loseScreen, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, false)));
+
+    if (_settings.Silent)
+        return;
 
     try
     {
         std::cout << "Your score is " << _counter.GetScore() << " with " << _lives->GetHealth() << " lives left." << std::endl;
+
+        // scripted and replayed runs don't belong to the highscores
+        if (_settings.Headless || _settings.Playback)
+            return;
+
+        // the file access runs on the worker, the table is printed once the loop sees the result
+        _highscores = _scorer.AppendAsync({ (int32_t)_counter.GetScore(), _lives->GetHealth(), _maper.GetMapPath(), _playerName });
+    }
+    catch (const HighscoreLoaderException& e) { std::cout << e.Message() << std::endl; }
+}
+
+void Game::ReportHighscores(bool wait)
+{
+    if (!_highscores.valid() || (!wait && _highscores.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+        return;
+
+    try
+    {
+        std::vector<Highscore> scores = _highscores.get();
+
         std::cout << "=======================================================" << std::endl;
         std::cout << "Table of highscores for the current map:" << std::endl;
         std::cout << "=======================================================" << std::endl;
 
-        _scorer.AppendHighscore({ (int32_t)_counter.GetScore(), _lives->GetHealth(), _maper.GetMapPath(), _playerName });
-        _scorer.Load(_maper.GetMapPath());
-        _scorer.PrintHighscore(std::cout);
+        HighscoreLoader::PrintHighscore(std::cout, scores);
     }
     catch (const HighscoreLoaderException& e) { std::cout << e.Message() << std::endl; }
 }
+
+void Game::ReportProfile() const
+{
+    if (!_profiler.IsEnabled())
+        return;
+
+    try
+    {
+        _profiler.PrintSummary(std::cout);
+
+        if (!_settings.ProfileCsv.empty())
+            _profiler.ExportCsv(_settings.ProfileCsv);
+
+        if (!_settings.ProfileTrace.empty())
+            _profiler.ExportTrace(_settings.ProfileTrace);
+    }
+    catch (const ProfilerException& e) { std::cout << e.Message() << std::endl; }
+}
+
+void Game::ReportLatency() const
+{
+    if (_tracer.IsEnabled())
+        _tracer.PrintSummary(std::cout, _renderer.GetDescription());
+}
+
+void Game::FinishReplay()
+{
+    try
+    {
+        if (!_settings.RecordPath.empty())
+            _recording.Save(_settings.RecordPath, (int32_t)_counter.GetScore());
+    }
+    catch (const ReplayException& e) { std::cout << e.Message() << std::endl; }
+
+    if (!_settings.Playback)
+        return;
+
+    if ((int32_t)_counter.GetScore() == _settings.Playback->GetScore() && _ticks == _settings.Playback->GetTicks())
+        std::cout << "Replay matches the recording." << std::endl;
+    else
+        std::cout << "Replay diverged! Score " << _counter.GetScore() << " in " << _ticks << " ticks, recorded score " << _settings.Playback->GetScore() << " in " << _settings.Playback->GetTicks() << " ticks." << std::endl;
+}
@@ -4,6 +4,43 @@
 #include "InputHandler.h"
 #include "FrameLimiter.h"
 #include "HighscoreLoader.h"
+#include "Profiler.h"
+#include "LatencyTracer.h"
+#include "Replay.h"
+
+#include <memory>
+
+/**
+ * @brief Structure used for storing game settings.
+*/
+struct GameSettings
+{
+    bool Headless; // null render backend, scripted platform, no frame limiting
+    bool Silent; // no console output, used by the batch runs
+    bool Profile; // section timers and frame time overlay
+    bool Latency; // input to present latency histogram printed at exit
+    uint32_t Seed; // seed of the game generator, replaced by the seed of the playback
+    std::string ProfileCsv; // exported at exit when set
+    std::string ProfileTrace; // chrome://tracing JSON, exported at exit when set
+    std::string RecordPath; // input recording saved at exit when set
+    std::shared_ptr<Replay> Playback; // recorded inputs replace the player, runs at full speed
+    RenderSettings Render; // ignored by the headless game
+    uint32_t Fps; // frame limit, 0 for the default or the vsync
+    bool Uncapped; // no frame limit, the frames are only paced by the vsync if requested
+    std::shared_ptr<const Map> Preloaded; // used instead of loading the map file, shared read-only by the batch games
+};
+
+/**
+ * @brief Structure used for storing the outcome of a game.
+*/
+struct GameResult
+{
+    bool Finished; // map cleared or all lives lost
+    bool Cleared;
+    uint64_t Ticks; // ticks until the end of the game
+    int32_t LivesLost;
+    uint32_t Score;
+};
 
 /**
  * @brief Class used for the main game logic.
@@ -12,6 +49,8 @@ class Game
 {
 private:
     static const uint32_t WINDOW_FPS = 60;
+    static const uint32_t TICK_RATE = 60;
+    static const uint32_t MAX_FRAME_TICKS = 5;
     static const uint32_t WINDOW_WIDTH = 580;
     static const uint32_t WINDOW_HEIGHT = 720;
 
@@ -19,13 +58,20 @@ private:
     static const uint32_t FRAME_WIDTH_OFFSET = 16;
     static const uint32_t FRAME_HEIGHT_OFFSET = 3;
 
-    static const uint32_t BRICK_ROWS = 10;
+    static const uint32_t BRICK_ROWS = 10; // size of the maps without the header
     static const uint32_t BRICK_COLUMNS = 8;
+    static const int32_t BRICK_WIDTH = 64;
+    static const int32_t BRICK_HEIGHT = 24;
+    static const int32_t BRICK_LAYER_MAX_SIZE = 2048; // larger fields are drawn directly, only the visible bricks
 
     static const int32_t INITIAL_LIVES = 3;
     static const int32_t INITIAL_SPEED_BALL = 5;
     static const int32_t INITIAL_SPEED_PLAYER = 7;
     static const int32_t INITIAL_BONUS_PROPABILITY = 31;
+    static const int32_t MAX_BALL_CONTACTS = 8;
+
+    static const int32_t AUTOPILOT_DEADZONE = 4;
+    static const uint64_t HEADLESS_TICK_LIMIT = 1000000;
 
 	/**
 	 * @brief Enumclass for the application state.
@@ -52,11 +98,28 @@ private:
     FrameLimiter _framer;
     ScoreCounter _counter;
     RenderManager _renderer;
+    TextureLoader _loader;
     HighscoreLoader _scorer;
 
     std::string _playerName;
+    GameSettings _settings;
+    uint64_t _ticks;
+    uint32_t _seed;
+    Random _random;
+    int32_t _aim;
+    GameResult _result;
+    Profiler _profiler;
+    LatencyTracer _tracer;
+    Replay _recording;
+    std::future<std::vector<Highscore>> _highscores; // pending result of the highscore append
+    std::shared_ptr<const Map> _map;
+
+    int32_t _fieldWidth;
+    int32_t _fieldHeight;
 
-    std::vector<std::shared_ptr<IDrawable>> _drawContext;
+    std::vector<std::shared_ptr<IDrawable>> _backgroundContext; // fixed to the window, under the field
+    std::vector<std::shared_ptr<IDrawable>> _drawContext; // scrolls with the field
+    std::vector<std::shared_ptr<IDrawable>> _overlayContext; // fixed to the window, over the field
 
     std::shared_ptr<Health> _lives;
     std::shared_ptr<BrickManager> _bricks;
@@ -74,34 +137,80 @@ public:
 	 * @param mapPath Map file path.
 	 * @param scorePath Score file path.
 	 * @param playerName Player's name.
+	 * @param settings Game settings.
 	*/
-	Game(const std::string& mapPath, const std::string& scorePath, const std::string& playerName);
+	Game(const std::string& mapPath, const std::string& scorePath, const std::string& playerName, const GameSettings& settings);
 
     /**
 	 * @brief Initialize the game. Mostly the game resources and the logic states.
+	 * @return True if the game is ready to be played.
 	*/
-	void Init();
+	bool Init();
     /**
      * @brief Begin the game loop.
     */
     void Play();
+    /**
+     * @brief Result getter.
+     * @return Outcome of the game, the current state if the game isn't finished.
+    */
+    GameResult GetResult() const;
+    /**
+     * @brief Map getter.
+     * @return Layout the game was initialized with, null before the initialization.
+    */
+    std::shared_ptr<const Map> GetMap() const;
 
 private:
 	/**
 	 * @brief Draw the game context.
+	 * @param alpha Interpolation factor between the previous and the current simulation state.
 	*/
-	void Draw();
+	void Draw(float alpha);
 	/**
-	 * @brief Update the game context.
+	 * @brief Update the game context. Advances the simulation by a single fixed tick.
+	 * @param time Event time of the end of the tick in milliseconds.
 	*/
-	void Update();
+	void Update(uint32_t time);
+    /**
+     * @brief Calculate the camera position. The camera follows the ball and stays inside the field.
+     * @param alpha Interpolation factor between the previous and the current simulation state.
+     * @return Position of the window in the field.
+    */
+    SDL_Point GetCamera(float alpha) const;
+    /**
+     * @brief Move the ball by a single tick. Contacts with the boundary, the platform and the bricks are resolved in order of occurrence.
+    */
+    void MoveBall();
 	/**
-	 * @brief Process events and user inputs for the game.
+	 * @brief Process events and user inputs for the game. The platform moves by the part of the tick the keys were held.
+	 * @param time Event time of the end of the tick in milliseconds.
 	*/
-	void ProcessEvents();
+	void ProcessEvents(uint32_t time);
+    /**
+     * @brief Generate inputs for the headless game. Platform follows the ball with a random offset picked on every serve and the game quits once it is over.
+    */
+    void Autopilot();
     /**
      * @brief End the game.
      * @param win Player win flag.
     */
     void EndGame(bool win);
+    /**
+     * @brief Print the highscore table once the highscore worker finishes.
+     * @param wait Block until the worker finishes, otherwise only poll.
+    */
+    void ReportHighscores(bool wait);
+    /**
+     * @brief Print and export the recorded profile.
+    */
+    void ReportProfile() const;
+    /**
+     * @brief Print the traced input latencies together with the renderer configuration.
+    */
+    void ReportLatency() const;
+    /**
+     * @brief Save the input recording and verify the playback against its recording.
+    */
+    void FinishReplay();
 };
@@ -1,16 +1,18 @@
 #include "GameObjects.h"
 
+#include <cmath>
 #include <cstdlib>
 #include <algorithm>
 
-GameObject::GameObject(const std::shared_ptr<Texture>& texture, int32_t x, int32_t y, int32_t width, int32_t height)
-    : _x(x), _y(y), _width(width), _height(height), _texture(texture) { }
+GameObject::GameObject(TextureHandle texture, int32_t x, int32_t y, int32_t width, int32_t height)
+    : _x(x), _y(y), _previousX(x), _previousY(y), _width(width), _height(height), _texture(texture) { }
 
 GameObject::~GameObject() { }
 
-void GameObject::Draw(const RenderManager& renderer) const
+void GameObject::Draw(const RenderManager& renderer, float alpha) const
 {
-    renderer.Draw(_texture->GetTexture(), { _x, _y, _width, _height });
+    SDL_Point position = GetPosition(alpha);
+    renderer.Draw(_texture, { position.x, position.y, _width, _height });
 }
 
 std::shared_ptr<IDrawable> GameObject::Clone() const
@@ -18,6 +20,17 @@ std::shared_ptr<IDrawable> GameObject::Clone() const
     return std::make_shared<GameObject>(*this);
 }
 
+void GameObject::SavePosition()
+{
+    _previousX = _x;
+    _previousY = _y;
+}
+
+SDL_Point GameObject::GetPosition(float alpha) const
+{
+    return { _previousX + (int32_t)std::lround((_x - _previousX) * alpha), _previousY + (int32_t)std::lround((_y - _previousY) * alpha) };
+}
+
 int32_t GameObject::GetX() const
 {
     return _x;
@@ -38,17 +51,20 @@ int32_t GameObject::GetHeight() const
     return _height;
 }
 
-Player::Player(const std::shared_ptr<Texture>& platform, int32_t x, int32_t y, int32_t width, int32_t height, int32_t maxSize, int32_t speed)
-    : GameObject(platform, x, y, width, height), _speed(speed), _maxSize(maxSize) { }
+Player::Player(TextureHandle platform, int32_t x, int32_t y, int32_t width, int32_t height, int32_t maxSize, int32_t speed)
+    : GameObject(platform, x, y, width, height), _speed(speed), _maxSize(maxSize), _remainder(0) { }
 
 std::shared_ptr<IDrawable> Player::Clone() const
 {
     return std::make_shared<Player>(*this);
 }
 
-void Player::Move(bool direction)
+void Player::Move(int32_t steps, int32_t total)
 {
-    _x += (direction) ? -_speed : _speed;
+    int32_t distance = _speed * steps + _remainder;
+
+    _x += distance / total;
+    _remainder = distance % total;
 }
 
 void Player::IncreaseSize()
@@ -67,26 +83,18 @@ void Player::CollisionBoundary(int32_t x, int32_t width)
     else if (_x >= width - _width) _x = width - _width - 1;
 }
 
-Brick::Brick(const std::shared_ptr<Texture>& brick, int32_t x, int32_t y, int32_t width, int32_t height, int32_t health)
-    : GameObject(brick, x, y, width, height), _health(health) { }
-
-std::shared_ptr<IDrawable> Brick::Clone() const
+Contact Contact::Earliest(const Contact& l, const Contact& r)
 {
-    return std::make_shared<Brick>(*this);
-}
+    if (l.Step < 0 || (r.Step >= 0 && r.Step < l.Step))
+        return r;
 
-void Brick::DecreaseHealth(const std::shared_ptr<Texture>& brick)
-{
-    --_health;
-    _texture = brick;
-}
+    if (r.Step < 0 || l.Step < r.Step)
+        return l;
 
-int32_t Brick::GetHealth() const
-{
-    return _health;
+    return { l.Step, l.FlipX || r.FlipX, l.FlipY || r.FlipY };
 }
 
-Ball::Ball(const std::shared_ptr<Texture>& ball, int32_t x, int32_t y, int32_t width, int32_t height, int32_t speed)
+Ball::Ball(TextureHandle ball, int32_t x, int32_t y, int32_t width, int32_t height, int32_t speed)
     : GameObject(ball, x, y, width, height), _speed(speed), _xDirection(0), _yDirection(0) { }
 
 std::shared_ptr<IDrawable> Ball::Clone() const
@@ -94,19 +102,24 @@ std::shared_ptr<IDrawable> Ball::Clone() const
     return std::make_shared<Ball>(*this);
 }
 
-void Ball::Start()
+void Ball::Start(Random& random)
 {
-    srand(time(0));
-    int dir = rand() % 2;
+    int dir = random.Range(2);
 
     _xDirection = dir ? 1 : -1;
     _yDirection = -1;
 }
 
-void Ball::Update()
+void Ball::Advance(int32_t steps)
 {
-    _x = NewPositionX();
-    _y = NewPositionY();
+    _x += _xDirection * steps;
+    _y += _yDirection * steps;
+}
+
+void Ball::Reflect(bool x, bool y)
+{
+    _xDirection = x ? -_xDirection : _xDirection;
+    _yDirection = y ? -_yDirection : _yDirection;
 }
 
 void Ball::FollowPlayer(const Player& player)
@@ -125,47 +138,83 @@ bool Ball::IsUnder(int32_t height)
     return _y >= height;
 }
 
-void Ball::CollisionBoundary(int32_t x, int32_t y, int32_t width)
+Contact Ball::CollisionCheck(const GameObject& object, int32_t steps) const
+{
+    return CollisionCheck({ object.GetX(), object.GetY(), object.GetWidth(), object.GetHeight() }, steps);
+}
+
+Contact Ball::CollisionCheck(const SDL_Rect& rectangle, int32_t steps) const
 {
-    if (_x <= x) _xDirection = 1;
-    else if (_x >= width - _width) _xDirection = -1;
+    int32_t entryX, exitX, entryY, exitY;
+
+    if (!Overlap(_x, _width, _xDirection, rectangle.x, rectangle.w, entryX, exitX) ||
+        !Overlap(_y, _height, _yDirection, rectangle.y, rectangle.h, entryY, exitY))
+        return { -1, false, false };
+
+    // the axis entered last is the one hit
+    int32_t entry = std::max(entryX, entryY);
 
-    if (_y <= y) _yDirection = 1;
+    if (entry < 1 || entry > steps || entry > std::min(exitX, exitY))
+        return { -1, false, false };
+
+    return { entry, entryX == entry, entryY == entry };
 }
 
-bool Ball::CollisionCheck(const std::shared_ptr<GameObject>& object)
+Contact Ball::CollisionBoundary(int32_t x, int32_t y, int32_t width, int32_t steps) const
 {
-    // lets call this double buffered AABB -> AABBAABB or AAAABBBB?
-    int32_t futurePosX = NewPositionX();
-    int32_t futurePosY = NewPositionY();
+    Contact contact = { -1, false, false };
 
-    if ((futurePosX + _width < object->GetX() || futurePosX > object->GetX() + object->GetWidth()) ||
-        (futurePosY + _height < object->GetY() || futurePosY > object->GetY() + object->GetHeight()))
-        return false;
+    if (_xDirection < 0 && _x - x <= steps)
+        contact = Contact::Earliest(contact, { std::max(_x - x, 0), true, false });
+    else if (_xDirection > 0 && width - _width - _x <= steps)
+        contact = Contact::Earliest(contact, { std::max(width - _width - _x, 0), true, false });
 
-    bool collisionX = _x + _width >= object->GetX() && _x <= object->GetX() + object->GetWidth();
-    bool collisionY = _y + _height >= object->GetY() && _y <= object->GetY() + object->GetHeight();
+    if (_yDirection < 0 && _y - y <= steps)
+        contact = Contact::Earliest(contact, { std::max(_y - y, 0), false, true });
 
-    if (collisionX && collisionY)
-        return false;
+    return contact;
+}
 
-    _xDirection = collisionX ? _xDirection : -_xDirection;
-    _yDirection = collisionY ? _yDirection : -_yDirection;
+int32_t Ball::GetSpeed() const
+{
+    return _speed;
+}
 
-    return true;
+int32_t Ball::GetDirectionX() const
+{
+    return _xDirection;
 }
 
-int32_t Ball::NewPositionX() const
+int32_t Ball::GetDirectionY() const
 {
-    return _x + _xDirection * _speed;
+    return _yDirection;
 }
 
-int32_t Ball::NewPositionY() const
+bool Ball::Overlap(int32_t position, int32_t size, int32_t direction, int32_t objectPosition, int32_t objectSize, int32_t& entry, int32_t& exit)
 {
-    return _y + _yDirection * _speed;
+    // edges touching count as an overlap
+    if (direction == 0)
+    {
+        entry = INT32_MIN;
+        exit = INT32_MAX;
+        return position + size >= objectPosition && position <= objectPosition + objectSize;
+    }
+
+    if (direction > 0)
+    {
+        entry = objectPosition - size - position;
+        exit = objectPosition + objectSize - position;
+    }
+    else
+    {
+        entry = position - objectPosition - objectSize;
+        exit = position + size - objectPosition;
+    }
+
+    return true;
 }
 
-Bonus::Bonus(const std::shared_ptr<Texture>& bonus, int32_t x, int32_t y, int32_t width, int32_t height, Type type)
+Bonus::Bonus(TextureHandle bonus, int32_t x, int32_t y, int32_t width, int32_t height, Type type)
     : GameObject(bonus, x, y, width, height), _type(type) { }
 
 std::shared_ptr<IDrawable> Bonus::Clone() const
@@ -175,6 +224,7 @@ std::shared_ptr<IDrawable> Bonus::Clone() const
 
 void Bonus::Update()
 {
+    SavePosition();
     _y += SPEED;
 }
 
@@ -183,22 +233,27 @@ Bonus::Type Bonus::GetType() const
     return _type;
 }
 
-BonusManager::BonusManager(const std::vector<std::shared_ptr<Texture>>& textures, int32_t width, int32_t height, int32_t propability)
-    : _width(width), _height(height), _propability(propability), _textures(textures)
+BonusManager::BonusManager(const std::vector<TextureHandle>& textures, int32_t width, int32_t height, int32_t propability, int32_t bottom, Random& random)
+    : _width(width), _height(height), _propability(propability), _bottom(bottom), _random(random), _textures(textures)
 {
     if (_propability < 0 || _propability > 100)
         _propability = PROPABILITY_DEFAULT;
+
+    _bonuses.reserve(CAPACITY);
 }
 
-void BonusManager::Draw(const RenderManager& renderer) const
+void BonusManager::Draw(const RenderManager& renderer, float alpha) const
 {
     for (size_t i = 0; i < _bonuses.size(); ++i)
-        _bonuses[i]->Draw(renderer);
+        _bonuses[i].Draw(renderer, alpha);
 }
 
 std::shared_ptr<IDrawable> BonusManager::Clone() const
 {
-    return std::make_shared<BonusManager>(*this);
+    // copies are sized to the content, the pool has to be reserved again
+    std::shared_ptr<BonusManager> clone = std::make_shared<BonusManager>(*this);
+    clone->_bonuses.reserve(CAPACITY);
+    return clone;
 }
 
 void BonusManager::Clear()
@@ -208,84 +263,130 @@ void BonusManager::Clear()
 
 void BonusManager::Generate(int32_t x, int32_t y)
 {
-    int temp = rand() % 100;
+    int temp = _random.Range(100);
 
     if (temp >= _propability)
         return;
 
-    temp = rand() % (int32_t)Bonus::Type::TYPE_COUNT;
-    _bonuses.push_back(std::make_shared<Bonus>(_textures[temp], x - _width / 2, y - _height / 2, _width, _height, (Bonus::Type)temp));
+    // the type is rolled even for a full pool to keep the generator in sync
+    temp = _random.Range((int32_t)Bonus::Type::TYPE_COUNT);
+
+    if (_bonuses.size() < CAPACITY)
+        _bonuses.emplace_back(_textures[temp], x - _width / 2, y - _height / 2, _width, _height, (Bonus::Type)temp);
 }
 
 void BonusManager::CollisionPlayer(Player& player, Ball& ball, ScoreCounter& score)
 {
-    for (auto& bonus : _bonuses)
+    for (size_t i = 0; i < _bonuses.size();)
     {
-        if (!bonus)
-            continue;
-
-        bonus->Update();
+        Bonus& bonus = _bonuses[i];
+        bonus.Update();
 
         // clear unreachable bonuses
-        if (bonus->GetY() > OUT_OF_BOUNDS_CONSTANT)
-        {
-            _bonuses.erase(std::find(_bonuses.begin(), _bonuses.end(), bonus));
-            continue;
-        }
+        bool removed = bonus.GetY() > _bottom;
 
         // collision 
-        if (bonus->GetX() + bonus->GetWidth() < player.GetX() || bonus->GetX() > player.GetX() + player.GetWidth() ||
-            bonus->GetY() + bonus->GetHeight() < player.GetY() || bonus->GetY() > player.GetY() + player.GetHeight())
-            continue;
+        if (!removed && !(bonus.GetX() + bonus.GetWidth() < player.GetX() || bonus.GetX() > player.GetX() + player.GetWidth() ||
+            bonus.GetY() + bonus.GetHeight() < player.GetY() || bonus.GetY() > player.GetY() + player.GetHeight()))
+        {
+            ApplyEffect(bonus.GetType(), player, ball, score);
+            removed = true;
+        }
 
-        switch (bonus->GetType())
+        if (!removed)
         {
-        case Bonus::Type::BIGGER_PLATFORM:
-            score.AddBonusScore(5);
-            player.IncreaseSize();
-            break;
-        case Bonus::Type::FASTER_PLATFORM:
-            score.AddBonusScore(5);
-            player.IncreaseSpeed();
-            break;
-        case Bonus::Type::FASTER_BALL:
-            score.AddBonusScore(15);
-            ball.IncreaseSpeed();
-            score.IncreaseSpeedMultiplier();
-            break;
-        case Bonus::Type::SCORE_100:
-            score.AddBonusScore(100);
-            break;
-        case Bonus::Type::SCORE_200:
-            score.AddBonusScore(200);
-            break;
-        case Bonus::Type::SCORE_300:
-            score.AddBonusScore(300);
-            break;
-        default:
-            break;
+            ++i;
+            continue;
         }
 
-        _bonuses.erase(std::find(_bonuses.begin(), _bonuses.end(), bonus));
+        // swap and pop - the last bonus takes the slot and is updated next
+        if (i + 1 != _bonuses.size())
+            bonus = _bonuses.back();
+
+        _bonuses.pop_back();
+    }
+}
+
+size_t BonusManager::GetCount() const
+{
+    return _bonuses.size();
+}
+
+void BonusManager::ApplyEffect(Bonus::Type type, Player& player, Ball& ball, ScoreCounter& score)
+{
+    switch (type)
+    {
+    case Bonus::Type::BIGGER_PLATFORM:
+        score.AddBonusScore(5);
+        player.IncreaseSize();
+        break;
+    case Bonus::Type::FASTER_PLATFORM:
+        score.AddBonusScore(5);
+        player.IncreaseSpeed();
+        break;
+    case Bonus::Type::FASTER_BALL:
+        score.AddBonusScore(15);
+        ball.IncreaseSpeed();
+        score.IncreaseSpeedMultiplier();
+        break;
+    case Bonus::Type::SCORE_100:
+        score.AddBonusScore(100);
+        break;
+    case Bonus::Type::SCORE_200:
+        score.AddBonusScore(200);
+        break;
+    case Bonus::Type::SCORE_300:
+        score.AddBonusScore(300);
+        break;
+    default:
+        break;
     }
 }
 
-BrickManager::BrickManager(const std::vector<std::shared_ptr<Texture>>& destroyable, const std::shared_ptr<Texture>& undestroyable, const Map& map, int32_t x, int32_t y, int32_t width, int32_t height)
-    : _undestroyableTexture(undestroyable), _destroyableTextures(destroyable)
+BrickManager::BrickManager(const std::vector<TextureHandle>& destroyable, TextureHandle undestroyable, const Map& map, int32_t x, int32_t y, int32_t width, int32_t height)
+    : _x(x), _y(y), _width(width), _height(height), _rows(map.GetRows()), _columns(map.GetColumns()), _remaining(0),
+    _undestroyableTexture(undestroyable), _destroyableTextures(destroyable), _cells((size_t)_rows * _columns), _revision(0)
 {
-    for (size_t i = 0; i < map.Layout.size(); ++i) for (size_t j = 0; j < map.Layout[0].size(); ++j)
+    for (int32_t i = 0; i < _rows; ++i) for (int32_t j = 0; j < _columns; ++j)
     {
-        if (map.Layout[i][j] == 0)
-            continue;
+        _cells[(size_t)i * _columns + j] = map.Get(i, j);
 
-        _bricks.push_back(std::make_shared<Brick>(map.Layout[i][j] == -1 ? _undestroyableTexture : _destroyableTextures[map.Layout[i][j] - 1], x + j * width, y + i * height, width, height, map.Layout[i][j] - 1));
+        if (map.Get(i, j) > 0)
+            ++_remaining;
     }
 }
 
-void BrickManager::Draw(const RenderManager& renderer) const
+void BrickManager::Draw(const RenderManager& renderer, float) const
 {
-    for (size_t i = 0; i < _bricks.size(); ++i)
-        _bricks[i]->Draw(renderer);
+    // a full draw covers every pending change, without a cached layer nothing else consumes them
+    _changed.clear();
+
+    // only the visible cells, the cost doesn't grow with the size of the map
+    SDL_Rect view = renderer.GetView();
+    int32_t firstRow, lastRow, firstColumn, lastColumn;
+
+    if (view.w <= 0 || view.h <= 0 || !ColumnSpan(view.x, view.x + view.w - 1, firstColumn, lastColumn) || !RowSpan(view.y, view.y + view.h - 1, firstRow, lastRow))
+        return;
+
+    for (int32_t i = firstRow; i <= lastRow; ++i) for (int32_t j = firstColumn; j <= lastColumn; ++j)
+        DrawCell(renderer, i * _columns + j);
+}
+
+uint64_t BrickManager::GetRevision() const
+{
+    return _revision;
+}
+
+bool BrickManager::DrawChanges(const RenderManager& renderer) const
+{
+    for (int32_t cell : _changed)
+    {
+        renderer.ClearRect(GetCellRect(cell), { 0, 0, 0, 0 });
+        DrawCell(renderer, cell);
+    }
+
+    _changed.clear();
+    return true;
 }
 
 std::shared_ptr<IDrawable> BrickManager::Clone() const
@@ -295,37 +396,103 @@ std::shared_ptr<IDrawable> BrickManager::Clone() const
 
 bool BrickManager::IsFinished() const
 {
-    return std::find_if(_bricks.begin(), _bricks.end(), [](const std::shared_ptr<Brick>& brick)-> bool { return brick->GetHealth() >= 0; }) == _bricks.end();
+    return _remaining == 0;
 }
 
-void BrickManager::CollisionBall(Ball& ball, BonusManager& bonuses, ScoreCounter& scorer)
+Contact BrickManager::CollisionBall(const Ball& ball, int32_t steps) const
+{
+    Contact contact = { -1, false, false };
+    int32_t firstRow, lastRow, firstColumn, lastColumn;
+
+    if (!SweptCells(ball, steps, firstRow, lastRow, firstColumn, lastColumn))
+        return contact;
+
+    for (int32_t i = firstRow; i <= lastRow; ++i) for (int32_t j = firstColumn; j <= lastColumn; ++j)
+    {
+        if (_cells[i * _columns + j] != 0)
+            contact = Contact::Earliest(contact, ball.CollisionCheck(GetCellRect(i * _columns + j), steps));
+    }
+
+    return contact;
+}
+
+void BrickManager::Hit(const Ball& ball, int32_t step, BonusManager& bonuses, ScoreCounter& scorer)
 {
-    for (auto& brick : _bricks)
+    int32_t firstRow, lastRow, firstColumn, lastColumn;
+
+    if (!SweptCells(ball, step, firstRow, lastRow, firstColumn, lastColumn))
+        return;
+
+    for (int32_t i = firstRow; i <= lastRow; ++i) for (int32_t j = firstColumn; j <= lastColumn; ++j)
     {
-        if (!brick || !ball.CollisionCheck(brick) || brick->GetHealth() < 0)
+        int32_t cell = i * _columns + j;
+        SDL_Rect rectangle = GetCellRect(cell);
+
+        if (_cells[cell] <= 0 || ball.CollisionCheck(rectangle, step).Step != step)
             continue;
 
-        if (brick->GetHealth() > 0)
-        {
-            brick->DecreaseHealth(_destroyableTextures[brick->GetHealth() - 1]);
-        }
-        else
+        ++_revision;
+        _changed.push_back(cell);
+
+        if (--_cells[cell] == 0)
         {
             scorer.AddScore();
-            bonuses.Generate(brick->GetX() + brick->GetWidth() / 2, brick->GetY() + brick->GetHeight() / 2);
+            bonuses.Generate(rectangle.x + rectangle.w / 2, rectangle.y + rectangle.h / 2);
 
-            _bricks.erase(std::find(_bricks.begin(), _bricks.end(), brick));
+            --_remaining;
         }
     }
 }
 
+bool BrickManager::SweptCells(const Ball& ball, int32_t steps, int32_t& firstRow, int32_t& lastRow, int32_t& firstColumn, int32_t& lastColumn) const
+{
+    int32_t x = ball.GetX() + ball.GetDirectionX() * steps;
+    int32_t y = ball.GetY() + ball.GetDirectionY() * steps;
+
+    return ColumnSpan(std::min(ball.GetX(), x), std::max(ball.GetX(), x) + ball.GetWidth(), firstColumn, lastColumn) &&
+        RowSpan(std::min(ball.GetY(), y), std::max(ball.GetY(), y) + ball.GetHeight(), firstRow, lastRow);
+}
+
+bool BrickManager::ColumnSpan(int32_t from, int32_t to, int32_t& first, int32_t& last) const
+{
+    if (to < _x || from > _x + _columns * _width)
+        return false;
+
+    first = std::max(from - _x - 1, 0) / _width; // edges are shared by neighbouring cells
+    last = std::min((to - _x) / _width, _columns - 1);
+    return true;
+}
+
+bool BrickManager::RowSpan(int32_t from, int32_t to, int32_t& first, int32_t& last) const
+{
+    if (to < _y || from > _y + _rows * _height)
+        return false;
+
+    first = std::max(from - _y - 1, 0) / _height;
+    last = std::min((to - _y) / _height, _rows - 1);
+    return true;
+}
+
+void BrickManager::DrawCell(const RenderManager& renderer, int32_t cell) const
+{
+    if (_cells[cell] == 0)
+        return;
+
+    renderer.Draw(_cells[cell] < 0 ? _undestroyableTexture : _destroyableTextures[_cells[cell] - 1], GetCellRect(cell));
+}
+
+SDL_Rect BrickManager::GetCellRect(int32_t cell) const
+{
+    return { _x + cell % _columns * _width, _y + cell / _columns * _height, _width, _height };
+}
+
 Background::Background(const std::vector<std::shared_ptr<IDrawable>>& layers)
     : _layers(layers) { }
 
-void Background::Draw(const RenderManager& renderer) const
+void Background::Draw(const RenderManager& renderer, float alpha) const
 {
     for (size_t i = 0; i < _layers.size(); ++i)
-        _layers[i]->Draw(renderer);
+        _layers[i]->Draw(renderer, alpha);
 }
 
 std::shared_ptr<IDrawable> Background::Clone() const
@@ -333,15 +500,20 @@ std::shared_ptr<IDrawable> Background::Clone() const
     return std::make_shared<Background>(*this);
 }
 
-Health::Health(const std::shared_ptr<Texture>& ball, const std::shared_ptr<Texture>& label, int32_t lives, int32_t x, int32_t y, int32_t labelWidth, int32_t labelHeight, int32_t ballWidth, int32_t ballHeight)
-    : _x(x), _y(y), _lives(lives), _ballWidth(ballWidth), _ballHeight(ballHeight), _labelWidth(labelWidth), _labelHeight(labelHeight), _ball(ball), _label(label) { }
+Health::Health(TextureHandle ball, TextureHandle label, int32_t lives, int32_t x, int32_t y, int32_t labelWidth, int32_t labelHeight, int32_t ballWidth, int32_t ballHeight)
+    : _x(x), _y(y), _lives(lives), _ballWidth(ballWidth), _ballHeight(ballHeight), _labelWidth(labelWidth), _labelHeight(labelHeight), _ball(ball), _label(label), _revision(0) { }
 
-void Health::Draw(const RenderManager& renderer) const
+uint64_t Health::GetRevision() const
+{
+    return _revision;
+}
+
+void Health::Draw(const RenderManager& renderer, float) const
 {
-    renderer.Draw(_label->GetTexture(), { _x, _y, _labelWidth, _labelHeight });
+    renderer.Draw(_label, { _x, _y, _labelWidth, _labelHeight });
 
     for (int32_t i = 0; i < _lives; ++i)
-        renderer.Draw(_ball->GetTexture(), { _x + _labelWidth + (int32_t)i * (_ballWidth + SPACING), _y + _labelHeight / 2 - _ballHeight / 2, _ballWidth, _ballHeight });
+        renderer.Draw(_ball, { _x + _labelWidth + (int32_t)i * (_ballWidth + SPACING), _y + _labelHeight / 2 - _ballHeight / 2, _ballWidth, _ballHeight });
 }
 
 std::shared_ptr<IDrawable> Health::Clone() const
@@ -352,9 +524,59 @@ std::shared_ptr<IDrawable> Health::Clone() const
 void Health::DecreaseHealth()
 {
     --_lives;
+    ++_revision;
 }
 
 int32_t Health::GetHealth() const
 {
     return _lives;
 }
+
+Layer::Layer(const std::shared_ptr<IDrawable>& content, int32_t x, int32_t y, int32_t width, int32_t height, bool opaque)
+    : _x(x), _y(y), _width(width), _height(height), _opaque(opaque), _content(content), _valid(false), _revision(0), _generation(0) { }
+
+void Layer::Draw(const RenderManager& renderer, float alpha) const
+{
+    if (!renderer.SupportsTargets())
+    {
+        _content->Draw(renderer, alpha);
+        return;
+    }
+
+    if (!_cache)
+        _cache = renderer.CreateTarget(_width, _height);
+
+    // the target can't be composited correctly, the content is drawn directly
+    if (!_cache)
+    {
+        _content->Draw(renderer, alpha);
+        return;
+    }
+
+    if (_valid && _generation != renderer.GetGeneration())
+        _valid = false;
+
+    if (!_valid || _revision != _content->GetRevision())
+    {
+        renderer.SetTarget(_cache->GetTexture(), _x, _y);
+
+        if (!_valid || !_content->DrawChanges(renderer))
+        {
+            renderer.ClearRect({ _x, _y, _width, _height }, _opaque ? Color{ 0, 0, 0, 255 } : Color{ 0, 0, 0, 0 });
+            _content->Draw(renderer, alpha);
+        }
+
+        renderer.SetTarget(nullptr, 0, 0);
+
+        _valid = true;
+        _revision = _content->GetRevision();
+        _generation = renderer.GetGeneration();
+    }
+
+    renderer.Draw(_cache->GetTexture(), _cache->GetSource(), { _x, _y, _width, _height });
+}
+
+std::shared_ptr<IDrawable> Layer::Clone() const
+{
+    return std::make_shared<Layer>(_content->Clone(), _x, _y, _width, _height, _opaque);
+}
@@ -3,6 +3,7 @@
 #include <memory>
 #include <vector>
 
+#include "Random.h"
 #include "MapLoader.h"
 #include "ScoreCounter.h"
 #include "RenderManager.h"
@@ -15,8 +16,19 @@ class IDrawable
 {
 public:
     virtual ~IDrawable() { };
-    virtual void Draw(const RenderManager& renderer) const = 0;
+    virtual void Draw(const RenderManager& renderer, float alpha) const = 0;
     virtual std::shared_ptr<IDrawable> Clone() const = 0;
+    /**
+     * @brief Revision getter. Revision changes whenever the drawn content changes, static content stays at zero.
+     * @return Value of the revision.
+    */
+    virtual uint64_t GetRevision() const { return 0; }
+    /**
+     * @brief Redraw only the parts changed since the last call.
+     * @param renderer Target renderer.
+     * @return False if the content has to be redrawn as a whole.
+    */
+    virtual bool DrawChanges(const RenderManager& renderer) const { return false; }
 };
 
 /**
@@ -27,9 +39,11 @@ class GameObject : public IDrawable
 protected:
     int32_t _x;
     int32_t _y;
+    int32_t _previousX;
+    int32_t _previousY;
     int32_t _width;
     int32_t _height;
-    std::shared_ptr<Texture> _texture;
+    TextureHandle _texture;
 
 public:
     /**
@@ -40,22 +54,34 @@ public:
      * @param width Object width.
      * @param height Object height.
     */
-    GameObject(const std::shared_ptr<Texture>& texture, int32_t x, int32_t y, int32_t width, int32_t height);
+    GameObject(TextureHandle texture, int32_t x, int32_t y, int32_t width, int32_t height);
     /**
      * @brief Virtual destructor. This class is meant to be inherited.
     */
     virtual ~GameObject();
     /**
-     * @brief Draw the object.
+     * @brief Draw the object. Position is interpolated between the previous and the current simulation state.
      * @param renderer Target renderer.
+     * @param alpha Interpolation factor between the previous (0) and the current (1) position.
     */
-    virtual void Draw(const RenderManager& renderer) const override;
+    virtual void Draw(const RenderManager& renderer, float alpha) const override;
     /**
      * @brief Clone the object.
      * @return Smart pointer to the object.
     */
     virtual std::shared_ptr<IDrawable> Clone() const override;
 
+    /**
+     * @brief Store the current position as the previous simulation state.
+    */
+    void SavePosition();
+
+    /**
+     * @brief Interpolated position getter.
+     * @param alpha Interpolation factor between the previous and the current simulation state.
+     * @return Position between the previous and the current one.
+    */
+    SDL_Point GetPosition(float alpha) const;
     /**
      * @brief The object position on horizontal axis getter.
      * @return Value of the position.
@@ -86,6 +112,7 @@ class Player : public GameObject
 private:
     int32_t _speed;
     int32_t _maxSize;
+    int32_t _remainder; // movement below a pixel carried to the next move
 
 public:
     /**
@@ -98,7 +125,7 @@ public:
      * @param maxSize Object max size.
      * @param speed Object speed.
     */
-    Player(const std::shared_ptr<Texture>& platform, int32_t x, int32_t y, int32_t width, int32_t height, int32_t maxSize, int32_t speed);
+    Player(TextureHandle platform, int32_t x, int32_t y, int32_t width, int32_t height, int32_t maxSize, int32_t speed);
     /**
      * @brief Clone the object.
      * @return Smart pointer to the object.
@@ -106,10 +133,11 @@ public:
     virtual std::shared_ptr<IDrawable> Clone() const override;
 
     /**
-     * @brief Move the object.
-     * @param direction Direction flag - positive is for left.
+     * @brief Move the object by a part of its speed, the movement below a pixel is carried to the next move.
+     * @param steps Part of the speed to move by, negative is for left.
+     * @param total Number of steps of the whole speed.
     */
-    void Move(bool direction);
+    void Move(int32_t steps, int32_t total);
     /**
      * @brief Increase size of the object. Size is increased by half of the difference of the max size and the current size.
     */
@@ -127,44 +155,25 @@ public:
 };
 
 /**
- * @brief Class used for brick object.
+ * @brief Structure used for storing contact of the moving ball.
 */
-class Brick : public GameObject
+struct Contact
 {
-private:
-    int32_t _health;
+    int32_t Step; // number of steps before the contact, negative if there is no contact
+    bool FlipX;
+    bool FlipY;
 
-public:
     /**
-     * @brief Create a new instance of the object.
-     * @param brick Object texture.
-     * @param x Object position on horizontal axis.
-     * @param y Object position on vertical axis.
-     * @param width Object width.
-     * @param height Object height.
-     * @param health Object health.
-    */
-    Brick(const std::shared_ptr<Texture>& brick, int32_t x, int32_t y, int32_t width, int32_t height, int32_t health);
-    /**
-     * @brief Clone the object.
-     * @return Smart pointer to the object.
-    */
-    virtual std::shared_ptr<IDrawable> Clone() const override;
-
-    /**
-     * @brief Decrease health of the object.
-     * @param brick Texture representating change in health of the object.
+     * @brief Pick the earlier of two contacts. Simultaneous contacts are merged.
+     * @param l First contact.
+     * @param r Second contact.
+     * @return The earlier contact.
     */
-    void DecreaseHealth(const std::shared_ptr<Texture>& brick);
-    /**
-     * @brief Health getter.
-     * @return Value of the health.
-    */
-    int32_t GetHealth() const;
+    static Contact Earliest(const Contact& l, const Contact& r);
 };
 
 /**
- * @brief Class used for ball object.
+ * @brief Class used for ball object. The ball moves diagonally, one step is a single unit on both axes.
 */
 class Ball : public GameObject
 {
@@ -183,7 +192,7 @@ public:
      * @param height Object height.
      * @param speed Object speed.
     */
-    Ball(const std::shared_ptr<Texture>& ball, int32_t x, int32_t y, int32_t width, int32_t height, int32_t speed);
+    Ball(TextureHandle ball, int32_t x, int32_t y, int32_t width, int32_t height, int32_t speed);
     /**
      * @brief Clone the object.
      * @return Smart pointer to the object.
@@ -192,12 +201,20 @@ public:
 
     /**
      * @brief Start the object movement.
+     * @param random Generator of the game to pick the direction.
     */
-    void Start();
+    void Start(Random& random);
     /**
-     * @brief Update the object movement.
+     * @brief Move the object along its direction.
+     * @param steps Number of steps.
     */
-    void Update();
+    void Advance(int32_t steps);
+    /**
+     * @brief Reflect the object direction.
+     * @param x Reflect on horizontal axis.
+     * @param y Reflect on vertical axis.
+    */
+    void Reflect(bool x, bool y);
     /**
      * @brief Follow player with the object movement.
      * @param player Player object to follow.
@@ -214,30 +231,58 @@ public:
     */
     bool IsUnder(int32_t height);
     /**
-     * @brief Check collision of the object with other GameObject. Double buffered axis aligned bounding box algorithm.
+     * @brief Find the earliest contact of the object with other GameObject. Swept axis aligned bounding box algorithm.
      * @param object Object to check collision with.
-     * @return True if objects collided.
+     * @param steps Number of steps to sweep.
+     * @return The earliest contact within the steps. Objects overlapping already don't collide.
     */
-    bool CollisionCheck(const std::shared_ptr<GameObject>& object);
+    Contact CollisionCheck(const GameObject& object, int32_t steps) const;
     /**
-     * @brief Check collision of the object with the playable boundary.
+     * @brief Find the earliest contact of the object with a static rectangle. Swept axis aligned bounding box algorithm.
+     * @param rectangle Rectangle to check collision with.
+     * @param steps Number of steps to sweep.
+     * @return The earliest contact within the steps. Objects overlapping already don't collide.
+    */
+    Contact CollisionCheck(const SDL_Rect& rectangle, int32_t steps) const;
+    /**
+     * @brief Find the earliest contact of the object with the playable boundary.
      * @param x Boundary position on horizontal axis.
      * @param y Boundary position on vertical axis.
      * @param width Boundary width.
+     * @param steps Number of steps to sweep.
+     * @return The earliest contact within the steps.
     */
-    void CollisionBoundary(int32_t x, int32_t y, int32_t width);
+    Contact CollisionBoundary(int32_t x, int32_t y, int32_t width, int32_t steps) const;
 
-private:
     /**
-     * @brief Calculate the next assumed position on horizontal axis.
-     * @return Value of the assummed position.
+     * @brief Speed getter.
+     * @return Number of steps per update.
     */
-    int32_t NewPositionX() const;
+    int32_t GetSpeed() const;
     /**
-     * @brief Calculate the next assumed position on vertical axis.
-     * @return Value of the assummed position.
+     * @brief Direction on horizontal axis getter.
+     * @return Value of the direction.
     */
-    int32_t NewPositionY() const;
+    int32_t GetDirectionX() const;
+    /**
+     * @brief Direction on vertical axis getter.
+     * @return Value of the direction.
+    */
+    int32_t GetDirectionY() const;
+
+private:
+    /**
+     * @brief Calculate the steps during which the object overlaps other object on a single axis.
+     * @param position Object position.
+     * @param size Object size.
+     * @param direction Object direction.
+     * @param objectPosition Other object position.
+     * @param objectSize Other object size.
+     * @param entry First overlapping step.
+     * @param exit Last overlapping step.
+     * @return True if the objects overlap at any step.
+    */
+    static bool Overlap(int32_t position, int32_t size, int32_t direction, int32_t objectPosition, int32_t objectSize, int32_t& entry, int32_t& exit);
 };
 
 /**
@@ -275,7 +320,7 @@ public:
      * @param height Object height.
      * @param type Object type.
     */
-    Bonus(const std::shared_ptr<Texture>& bonus, int32_t x, int32_t y, int32_t width, int32_t height, Type type);
+    Bonus(TextureHandle bonus, int32_t x, int32_t y, int32_t width, int32_t height, Type type);
     /**
      * @brief Clone the object.
      * @return Smart pointer to the object.
@@ -294,19 +339,21 @@ public:
 };
 
 /**
- * @brief Class used for managing Bonus class objects.
+ * @brief Class used for managing Bonus class objects. Bonuses are stored by value in a fixed-capacity pool kept dense by swap-and-pop removal.
 */
 class BonusManager : public IDrawable
 {
 private:
     static const int32_t PROPABILITY_DEFAULT = 5;
-    static const int32_t OUT_OF_BOUNDS_CONSTANT = 1000;
+    static const size_t CAPACITY = 1024; // bonuses dropped over the capacity are discarded
 
     int32_t _width;
     int32_t _height;
     int32_t _propability;
-    std::vector<std::shared_ptr<Bonus>> _bonuses;
-    std::vector<std::shared_ptr<Texture>> _textures;
+    int32_t _bottom;
+    Random& _random;
+    std::vector<Bonus> _bonuses; // reserved to the capacity, never reallocated
+    std::vector<TextureHandle> _textures;
 
 public:
     /**
@@ -315,13 +362,16 @@ public:
      * @param width Bonus object width.
      * @param height Bonus object height.
      * @param propability Bonus propability chance.
+     * @param bottom Position on vertical axis below which the bonuses are unreachable.
+     * @param random Generator of the game to roll the bonuses, has to outlive the object manager.
     */
-    BonusManager(const std::vector<std::shared_ptr<Texture>>& textures, int32_t width, int32_t height, int32_t propability);
+    BonusManager(const std::vector<TextureHandle>& textures, int32_t width, int32_t height, int32_t propability, int32_t bottom, Random& random);
     /**
       * @brief Draw the object manager.
       * @param renderer Target renderer.
+      * @param alpha Interpolation factor between the previous and the current simulation state.
      */
-    virtual void Draw(const RenderManager& renderer) const override;
+    virtual void Draw(const RenderManager& renderer, float alpha) const override;
     /**
      * @brief Clone the object manager.
      * @return Smart pointer to the object manager.
@@ -333,48 +383,86 @@ public:
     */
     void Clear();
     /**
-     * @brief Generate a new bonus.
+     * @brief Generate a new bonus. Nothing is generated once the pool is full.
      * @param x Postion on horizontal axis to generate bonus.
      * @param y Postion on vertical axis to generate bonus.
     */
     void Generate(int32_t x, int32_t y);
     /**
-     * @brief Check collision of the object manager with Player object.
+     * @brief Move the bonuses and check their collision with Player object in a single pass. Caught and unreachable bonuses are removed.
      * @param player Player object to check collision with & apply bonus effects.
      * @param ball Ball object to apply bonus effects.
      * @param score ScoreCounter object to aply bonus effects.
     */
     void CollisionPlayer(Player& player, Ball& ball, ScoreCounter& score);
+    /**
+     * @brief Number of bonuses getter.
+     * @return Number of the falling bonuses.
+    */
+    size_t GetCount() const;
+
+private:
+    /**
+     * @brief Apply the effect of a caught bonus.
+     * @param type Type of the caught bonus.
+     * @param player Player object to apply bonus effects.
+     * @param ball Ball object to apply bonus effects.
+     * @param score ScoreCounter object to aply bonus effects.
+    */
+    static void ApplyEffect(Bonus::Type type, Player& player, Ball& ball, ScoreCounter& score);
 };
 
 /**
- * @brief Class used for managing Brick class objects.
+ * @brief Class used for managing bricks stored in a compact grid of cells.
 */
 class BrickManager : public IDrawable
 {
 private:
-    std::shared_ptr<Texture> _undestroyableTexture;
-    std::vector<std::shared_ptr<Texture>> _destroyableTextures;
+    int32_t _x;
+    int32_t _y;
+    int32_t _width;
+    int32_t _height;
+    int32_t _rows;
+    int32_t _columns;
+    int32_t _remaining;
+
+    TextureHandle _undestroyableTexture;
+    std::vector<TextureHandle> _destroyableTextures;
 
-    std::vector<std::shared_ptr<Brick>> _bricks;
+    std::vector<int8_t> _cells; // uniform grid in row-major order, -1 is a wall, 0 is empty, positive value is the remaining hits
+
+    uint64_t _revision;
+    mutable std::vector<int32_t> _changed; // cells changed since the last Draw or DrawChanges
 
 public:
     /**
      * @brief Create a new instance of the object manager.
-     * @param destroyable Object manager texture atlas for the Brick class objects that are destroyable.
-     * @param undestroyable Object manager texture for the Brick class objects that are not destroyable.
-     * @param map Object manager Map object for Brick objects layout.
+     * @param destroyable Object manager texture atlas for the bricks that are destroyable, indexed by the remaining hits.
+     * @param undestroyable Object manager texture for the bricks that are not destroyable.
+     * @param map Object manager Map object for the bricks layout.
      * @param x Object manager boundary position on horizontal axis.
      * @param y Object manager boundary position on vertical axis.
      * @param width Object manager boundary width.
      * @param height Object manager boundary height.
     */
-    BrickManager(const std::vector<std::shared_ptr<Texture>>& destroyable, const std::shared_ptr<Texture>& undestroyable, const Map& map, int32_t x, int32_t y, int32_t width, int32_t height);
+    BrickManager(const std::vector<TextureHandle>& destroyable, TextureHandle undestroyable, const Map& map, int32_t x, int32_t y, int32_t width, int32_t height);
     /**
-      * @brief Draw the object manager.
+     * @brief Revision getter.
+     * @return Value of the revision.
+    */
+    virtual uint64_t GetRevision() const override;
+    /**
+     * @brief Redraw only the cells changed since the last call.
+     * @param renderer Target renderer.
+     * @return Always true.
+    */
+    virtual bool DrawChanges(const RenderManager& renderer) const override;
+    /**
+      * @brief Draw the bricks inside the visible part of the renderer.
       * @param renderer Target renderer.
+      * @param alpha Interpolation factor between the previous and the current simulation state.
      */
-    virtual void Draw(const RenderManager& renderer) const override;
+    virtual void Draw(const RenderManager& renderer, float alpha) const override;
     /**
      * @brief Clone the object manager.
      * @return Smart pointer to the object manager.
@@ -382,17 +470,68 @@ public:
     virtual std::shared_ptr<IDrawable> Clone() const override;
 
     /**
-     * @brief Check if all destroyable Brick objects are destroyed.
-     * @return True if all destroyable Brick objects are destroyed.
+     * @brief Check if all destroyable bricks are destroyed.
+     * @return True if all destroyable bricks are destroyed.
     */
     bool IsFinished() const;
     /**
-     * @brief Check collision of the object manager with Ball object.
+     * @brief Find the earliest contact of Ball object with the managed bricks.
      * @param ball Ball object to check collision with.
+     * @param steps Number of steps to sweep.
+     * @return The earliest contact within the steps.
+    */
+    Contact CollisionBall(const Ball& ball, int32_t steps) const;
+    /**
+     * @brief Hit all the bricks Ball object contacts at the given step.
+     * @param ball Ball object hitting the bricks.
+     * @param step Step of the contact.
      * @param bonuses BonusManager object to potential bonus generation.
      * @param scorer ScoreCounter object to aggregate score.
     */
-    void CollisionBall(Ball& ball, BonusManager& bonuses, ScoreCounter& scorer);
+    void Hit(const Ball& ball, int32_t step, BonusManager& bonuses, ScoreCounter& scorer);
+
+private:
+    /**
+     * @brief Map the swept bounding box of Ball object to the grid cells.
+     * @param ball Ball object.
+     * @param steps Number of steps to sweep.
+     * @param firstRow First overlapped row.
+     * @param lastRow Last overlapped row.
+     * @param firstColumn First overlapped column.
+     * @param lastColumn Last overlapped column.
+     * @return True if the box overlaps any cell.
+    */
+    bool SweptCells(const Ball& ball, int32_t steps, int32_t& firstRow, int32_t& lastRow, int32_t& firstColumn, int32_t& lastColumn) const;
+    /**
+     * @brief Map a span on horizontal axis to the grid columns.
+     * @param from Span start.
+     * @param to Span end (inclusive).
+     * @param first First overlapped column.
+     * @param last Last overlapped column.
+     * @return True if the span overlaps any column.
+    */
+    bool ColumnSpan(int32_t from, int32_t to, int32_t& first, int32_t& last) const;
+    /**
+     * @brief Map a span on vertical axis to the grid rows.
+     * @param from Span start.
+     * @param to Span end (inclusive).
+     * @param first First overlapped row.
+     * @param last Last overlapped row.
+     * @return True if the span overlaps any row.
+    */
+    bool RowSpan(int32_t from, int32_t to, int32_t& first, int32_t& last) const;
+    /**
+     * @brief Draw a single cell.
+     * @param renderer Target renderer.
+     * @param cell Index of the cell.
+    */
+    void DrawCell(const RenderManager& renderer, int32_t cell) const;
+    /**
+     * @brief Cell rectangle getter.
+     * @param cell Index of the cell.
+     * @return Rectangle of the cell.
+    */
+    SDL_Rect GetCellRect(int32_t cell) const;
 };
 
 /**
@@ -412,8 +551,9 @@ public:
     /**
       * @brief Draw the object.
       * @param renderer Target renderer.
+      * @param alpha Interpolation factor between the previous and the current simulation state.
      */
-    virtual void Draw(const RenderManager& renderer) const override;
+    virtual void Draw(const RenderManager& renderer, float alpha) const override;
     /**
      * @brief Clone the object.
      * @return Smart pointer to the object.
@@ -436,8 +576,9 @@ private:
     int32_t _ballHeight;
     int32_t _labelWidth;
     int32_t _labelHeight;
-    std::shared_ptr<Texture> _ball;
-    std::shared_ptr<Texture> _label;
+    TextureHandle _ball;
+    TextureHandle _label;
+    uint64_t _revision;
 
 public:
     /**
@@ -452,12 +593,18 @@ public:
      * @param ballWidth Width of the ball texture.
      * @param ballHeight Height of the ball texture.
     */
-    Health(const std::shared_ptr<Texture>& ball, const std::shared_ptr<Texture>& label, int32_t lives, int32_t x, int32_t y, int32_t labelWidth, int32_t labelHeight, int32_t ballWidth, int32_t ballHeight);
+    Health(TextureHandle ball, TextureHandle label, int32_t lives, int32_t x, int32_t y, int32_t labelWidth, int32_t labelHeight, int32_t ballWidth, int32_t ballHeight);
+    /**
+     * @brief Revision getter.
+     * @return Value of the revision.
+    */
+    virtual uint64_t GetRevision() const override;
     /**
       * @brief Draw the object.
       * @param renderer Target renderer.
+      * @param alpha Interpolation factor between the previous and the current simulation state.
      */
-    virtual void Draw(const RenderManager& renderer) const override;
+    virtual void Draw(const RenderManager& renderer, float alpha) const override;
     /**
      * @brief Clone the object.
      * @return Smart pointer to the object.
@@ -474,3 +621,46 @@ public:
     */
     int32_t GetHealth() const;
 };
+
+/**
+ * @brief Class used for caching drawn content in a render target. Content is redrawn only when its revision changes.
+*/
+class Layer : public IDrawable
+{
+private:
+    int32_t _x;
+    int32_t _y;
+    int32_t _width;
+    int32_t _height;
+    bool _opaque;
+    std::shared_ptr<IDrawable> _content;
+
+    // cache state
+    mutable bool _valid;
+    mutable uint64_t _revision;
+    mutable uint32_t _generation;
+    mutable std::shared_ptr<Texture> _cache;
+
+public:
+    /**
+     * @brief Create a new instance of the object.
+     * @param content Object to be cached.
+     * @param x Layer position on horizontal axis.
+     * @param y Layer position on vertical axis.
+     * @param width Layer width.
+     * @param height Layer height.
+     * @param opaque Opaque layer is cleared with black, transparent one with transparent color.
+    */
+    Layer(const std::shared_ptr<IDrawable>& content, int32_t x, int32_t y, int32_t width, int32_t height, bool opaque);
+    /**
+      * @brief Draw the object. Changed content is rendered into the cache first.
+      * @param renderer Target renderer.
+      * @param alpha Interpolation factor between the previous and the current simulation state.
+     */
+    virtual void Draw(const RenderManager& renderer, float alpha) const override;
+    /**
+     * @brief Clone the object. The cache is not shared.
+     * @return Smart pointer to the object.
+    */
+    virtual std::shared_ptr<IDrawable> Clone() const override;
+};
@@ -1,54 +1,902 @@
 #include "HighscoreLoader.h"
+#include "Utility.h"
 
 #include <string>
-#include <sstream>
+#include <memory>
+#include <cstring>
 #include <algorithm>
 
+#include <cstdio>
+#include <cerrno>
+#include <cinttypes>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+// index layout - "index <generation> <inode> <offset> <fingerprint>" line followed by the best scores of every map in the score file format
+static const std::string INDEX_HEADER = "index";
+static const std::string INDEX_EXTENSION = ".index";
+
+// segment list - "segment <generation>" line followed by a "<generation> <level>" line for every live segment, oldest first
+static const std::string SEGMENT_HEADER = "segment";
+static const std::string SEGMENT_EXTENSION = ".segment";
+
+// segment file - entries sorted by map and score, then the best scores of every map and the "summary <offset of the best scores>" line
+static const std::string SUMMARY_HEADER = "summary";
+static const size_t WRITE_BUFFER = 1 << 16;
+static const std::string PENDING_EXTENSION = ".pending";
+static const std::string LOCK_EXTENSION = ".lock";
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ull;
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+/**
+ * @brief Check for a blank character inside of a line.
+ * @param ch Character to check.
+ * @return True if the character is blank.
+*/
+static bool IsBlank(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\r';
+}
+
+/**
+ * @brief Cut the next blank separated token.
+ * @param cursor Position in the line, moved past the token.
+ * @param last End of the line.
+ * @param first Output first character of the token.
+ * @return Length of the token, zero at the end of the line.
+*/
+static size_t NextToken(const char*& cursor, const char* last, const char*& first)
+{
+    while (cursor < last && IsBlank(*cursor)) ++cursor;
+    first = cursor;
+    while (cursor < last && !IsBlank(*cursor)) ++cursor;
+    return cursor - first;
+}
+
+/**
+ * @brief Parse a whole token as a number.
+ * @param first First character of the token.
+ * @param length Length of the token.
+ * @param value Output value.
+ * @return True if the token is a number in the range of the value.
+*/
+static bool ParseNumber(const char* first, size_t length, int32_t& value)
+{
+    const char* last = first + length;
+    bool negative = first < last && *first == '-';
+
+    if (first < last && (*first == '-' || *first == '+'))
+        ++first;
+
+    if (first == last)
+        return false;
+
+    int64_t number = 0;
+    for (; first < last; ++first)
+    {
+        if (*first < '0' || *first > '9')
+            return false;
+
+        number = number * 10 + (*first - '0');
+        if (number > (int64_t)INT32_MAX + 1)
+            return false;
+    }
+
+    number = negative ? -number : number;
+    if (number > INT32_MAX)
+        return false;
+
+    value = (int32_t)number;
+    return true;
+}
+
+/**
+ * @brief Split the path to the directory and the file name.
+ * @param path File path.
+ * @param directory Output directory, the current one for a bare file name.
+ * @param name Output file name.
+*/
+static void SplitPath(const std::string& path, std::string& directory, std::string& name)
+{
+    size_t slash = path.find_last_of('/');
+
+    directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    name = slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+/**
+ * @brief Write the whole buffer to the descriptor.
+ * @param fd File descriptor.
+ * @param data Data to write.
+ * @param size Size of the data.
+ * @return True if everything was written.
+*/
+static bool WriteAll(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t count = write(fd, data, size);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+
+        data += count;
+        size -= (size_t)count;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Flush the renames inside the directory of the file to the disk.
+ * @param path Path of a file in the directory.
+ * @return True if the directory was flushed.
+*/
+static bool SyncDirectory(const std::string& path)
+{
+    std::string directory;
+    std::string name;
+    SplitPath(path, directory, name);
+
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (fd < 0)
+        return false;
+
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
 HighscoreLoader::HighscoreLoader(const std::string& fileName)
-    : _filePath(fileName) { }
+    : _filePath(fileName), _indexPath(fileName + INDEX_EXTENSION), _segmentPath(fileName + SEGMENT_EXTENSION), _indexed(false),
+    _generation(0), _inode(0), _offset(0), _fingerprint(0), _stopping(false) { }
+
+HighscoreLoader::~HighscoreLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+
+    _condition.notify_one();
+
+    // pending appends are still written
+    if (_worker.joinable())
+        _worker.join();
+}
 
 void HighscoreLoader::Load(const std::string& mapFilter)
 {
-    std::ifstream ifs(_filePath, std::ios::in);
+    Refresh();
+
+    auto it = _index.find(mapFilter);
+    _scores = it != _index.end() ? it->second : std::vector<Highscore>();
+}
+
+std::string HighscoreLoader::GetIndexPath() const
+{
+    return _indexPath;
+}
+
+const std::vector<Highscore>& HighscoreLoader::GetHighscores() const
+{
+    return _scores;
+}
+
+void HighscoreLoader::PrintHighscore(std::ostream& os) const
+{
+    PrintHighscore(os, _scores);
+}
+
+void HighscoreLoader::PrintHighscore(std::ostream& os, const std::vector<Highscore>& scores)
+{
+    for (size_t i = 0; i < scores.size(); ++i)
+        os << scores[i].Score << "\t" << scores[i].Lives << "\t" << scores[i].Player << std::endl;
+}
+
+void HighscoreLoader::AppendHighscore(const Highscore& score)
+{
+    // a single write of the whole entry, concurrent appends to the end of the file can't interleave
+    std::string entry = Format(score);
+    int fd = OpenLocked(LOCK_SH);
+    ssize_t written;
+
+    do written = write(fd, entry.data(), entry.size());
+    while (written < 0 && errno == EINTR);
+
+    struct stat info;
+    bool large = fstat(fd, &info) == 0 && (uint64_t)info.st_size >= COMPACTION_SIZE;
+    close(fd);
+
+    if (written != (ssize_t)entry.size())
+        throw HighscoreLoaderException("Failed to append the highscore!");
+
+    // the score is already stored, failed compaction is retried with the next append
+    if (large)
+    {
+        try { Compact(); }
+        catch (const HighscoreLoaderException&) { }
+    }
+}
+
+bool HighscoreLoader::Compact()
+{
+    int lock = open((_filePath + LOCK_EXTENSION).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if (lock < 0)
+        throw HighscoreLoaderException("Failed to open the compaction lock!");
+
+    // only one compaction at a time, the others skip it
+    if (flock(lock, LOCK_EX | LOCK_NB) != 0)
+    {
+        close(lock);
+        return false;
+    }
+
+    try
+    {
+        std::vector<Segment> segments;
+        uint64_t generation = ReadManifest(segments);
+
+        // left by a compaction interrupted after writing the segment list
+        unlink(GetPendingPath(generation).c_str());
 
-    if (ifs.fail())
+        // the exclusive lock waits for the appends in progress, the following ones open a new score file
+        std::string pendingPath = GetPendingPath(generation + 1);
+        if (access(pendingPath.c_str(), F_OK) != 0)
+        {
+            int fd = OpenLocked(LOCK_EX);
+            bool renamed = rename(_filePath.c_str(), pendingPath.c_str()) == 0;
+            close(fd);
+
+            if (!renamed)
+                throw HighscoreLoaderException("Failed to rename the score file for the compaction!");
+        }
+
+        std::vector<Highscore> pending;
+        {
+            MappedFile file(pendingPath);
+            const char* cursor = (const char*)file.GetData();
+            const char* end = cursor + file.GetSize();
+            const char* lineEnd;
+            Highscore score;
+
+            // torn entries are dropped, entries appended after a torn one are kept
+            for (; cursor < end; cursor = lineEnd + 1)
+            {
+                if ((lineEnd = (const char*)std::memchr(cursor, '\n', end - cursor)) == nullptr)
+                    lineEnd = end;
+
+                if (ParseEntry(cursor, lineEnd, score.Map, score.Score, score.Lives, score.Player))
+                    pending.push_back(score);
+            }
+        }
+
+        std::sort(pending.begin(), pending.end(), IsBefore);
+
+        // the new segment takes over the newest segments while they fill up a tier, every entry is rewritten only once per level
+        Segment created = { generation + 1, 0 };
+        size_t kept = segments.size();
+
+        while (kept >= TIER_FANOUT - 1 && std::all_of(segments.begin() + (kept - (TIER_FANOUT - 1)), segments.begin() + kept, [&](const Segment& segment) { return segment.Level == created.Level; }))
+        {
+            kept -= TIER_FANOUT - 1;
+            ++created.Level;
+        }
+
+        std::vector<Segment> merged(segments.begin() + kept, segments.end());
+        segments.resize(kept);
+        segments.push_back(created);
+
+        WriteSegment(created, pending, merged);
+        WriteManifest(generation + 1, segments);
+
+        // the compacted scores are on the disk, the sources can go
+        unlink(pendingPath.c_str());
+        RemoveStale(segments);
+    }
+    catch (const HighscoreLoaderException&)
+    {
+        close(lock);
+        throw;
+    }
+
+    close(lock);
+    return true;
+}
+
+std::future<std::vector<Highscore>> HighscoreLoader::AppendAsync(const Highscore& score)
+{
+    return Submit([this, score]
+        {
+            AppendHighscore(score);
+            Load(score.Map);
+            return _scores;
+        });
+}
+
+std::future<std::vector<Highscore>> HighscoreLoader::LoadAsync(const std::string& map)
+{
+    return Submit([this, map]
+        {
+            Load(map);
+            return _scores;
+        });
+}
+
+bool HighscoreLoader::IsBetter(const Highscore& l, const Highscore& r)
+{
+    return l.Score == r.Score ? l.Lives > r.Lives : l.Score > r.Score;
+}
+
+std::future<std::vector<Highscore>> HighscoreLoader::Submit(std::function<std::vector<Highscore>()> job)
+{
+    std::packaged_task<std::vector<Highscore>()> task(job);
+    std::future<std::vector<Highscore>> result = task.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back(std::move(task));
+
+        if (!_worker.joinable())
+            _worker = std::thread(&HighscoreLoader::Work, this);
+    }
+
+    _condition.notify_one();
+    return result;
+}
+
+void HighscoreLoader::Work()
+{
+    while (true)
+    {
+        std::packaged_task<std::vector<Highscore>()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+
+            if (_jobs.empty())
+                return;
+
+            task = std::move(_jobs.front());
+            _jobs.pop_front();
+        }
+
+        // exceptions of the job end up in its future
+        task();
+    }
+}
+
+void HighscoreLoader::Refresh()
+{
+    if (!_indexed)
+    {
+        ReadIndex();
+        _indexed = true;
+    }
+
+    std::vector<Segment> segments;
+    uint64_t generation = ReadManifest(segments);
+
+    // score file is missing right after a compaction took it
+    struct stat info;
+    uint64_t inode = stat(_filePath.c_str(), &info) == 0 ? (uint64_t)info.st_ino : 0;
+    MappedFile file(_filePath);
+
+    if (inode != 0 && !file.IsOpen())
         throw HighscoreLoaderException("Failed to initialize output file stream!");
 
+    const char* data = (const char*)file.GetData();
+    bool changed = false;
+
+    // compaction or a replaced score file, the index is rebuilt
+    if (generation != _generation || inode != _inode || _offset > file.GetSize() || Fingerprint(data, _offset) != _fingerprint)
+    {
+        _index.clear();
+        _inode = inode;
+        _offset = 0;
+        changed = true;
+
+        // a compaction can remove the merged segments right after the list was read, the new list covers them
+        while (!MergeSummaries(segments))
+        {
+            uint64_t current = ReadManifest(segments);
+
+            if (current == generation)
+                throw HighscoreLoaderException("Failed to read the highscore segment!");
+
+            _index.clear();
+            generation = current;
+        }
+
+        _generation = generation;
+
+        // score file taken by a compaction that isn't finished yet
+        MappedFile pending(GetPendingPath(generation + 1));
+        Merge((const char*)pending.GetData(), (const char*)pending.GetData() + pending.GetSize());
+    }
+
+    const char* cursor = Merge(data + _offset, data + file.GetSize());
+
+    if (!changed && (uint64_t)(cursor - data) == _offset)
+        return;
+
+    _offset = cursor - data;
+    _fingerprint = Fingerprint(data, _offset);
+
+    // the index is only a cache, read-only score directories keep merging from the last saved offset
+    try { WriteIndex(); }
+    catch (const HighscoreLoaderException&) { }
+}
+
+const char* HighscoreLoader::Merge(const char* cursor, const char* end)
+{
     int32_t score;
     int32_t lives;
     std::string map;
     std::string player;
+    const char* lineEnd;
+
+    // only complete lines, the last one may still be written, header lines and torn entries don't parse
+    while (cursor < end && (lineEnd = (const char*)std::memchr(cursor, '\n', end - cursor)) != nullptr)
+    {
+        if (ParseEntry(cursor, lineEnd, map, score, lives, player))
+            Insert(map, score, lives, player);
+
+        cursor = lineEnd + 1;
+    }
+
+    return cursor;
+}
+
+int HighscoreLoader::OpenLocked(int operation) const
+{
+    while (true)
+    {
+        int fd = open(_filePath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+
+        if (fd < 0)
+            throw HighscoreLoaderException("Failed to initialize input file stream!");
+
+        if (flock(fd, operation) != 0)
+        {
+            close(fd);
+            throw HighscoreLoaderException("Failed to lock the score file!");
+        }
+
+        // the file could be taken by a compaction while waiting for the lock
+        struct stat opened;
+        struct stat current;
+
+        if (fstat(fd, &opened) == 0 && stat(_filePath.c_str(), &current) == 0 && opened.st_dev == current.st_dev && opened.st_ino == current.st_ino)
+            return fd;
+
+        close(fd);
+    }
+}
+
+std::string HighscoreLoader::GetPendingPath(uint64_t generation) const
+{
+    return _filePath + PENDING_EXTENSION + std::to_string(generation);
+}
+
+std::string HighscoreLoader::GetSegmentPath(const Segment& segment) const
+{
+    return _segmentPath + "." + std::to_string(segment.Generation) + "-" + std::to_string(segment.Level);
+}
+
+uint64_t HighscoreLoader::ReadManifest(std::vector<Segment>& segments) const
+{
+    segments.clear();
+
+    MappedFile file(_segmentPath);
+    const char* data = (const char*)file.GetData();
+    const char* end = data + file.GetSize();
+    const char* lineEnd = data != nullptr ? (const char*)std::memchr(data, '\n', end - data) : nullptr;
+
+    if (lineEnd == nullptr)
+        return 0;
+
+    std::string header(data, lineEnd);
+    uint64_t generation;
+    char tail;
+
+    if (std::sscanf(header.c_str(), (SEGMENT_HEADER + " %" SCNu64 " %c").c_str(), &generation, &tail) != 1)
+        return 0;
+
+    // the list is replaced at once, a line that doesn't parse means a foreign file
+    for (const char* cursor = lineEnd + 1; cursor < end; cursor = lineEnd + 1)
+    {
+        Segment segment;
+        lineEnd = (const char*)std::memchr(cursor, '\n', end - cursor);
+
+        if (lineEnd == nullptr || std::sscanf(std::string(cursor, lineEnd).c_str(), "%" SCNu64 " %" SCNu32 " %c", &segment.Generation, &segment.Level, &tail) != 2)
+            throw HighscoreLoaderException("Invalid highscore segment list!");
+
+        segments.push_back(segment);
+    }
+
+    return generation;
+}
+
+void HighscoreLoader::WriteManifest(uint64_t generation, const std::vector<Segment>& segments) const
+{
+    std::string content = SEGMENT_HEADER + " " + std::to_string(generation) + "\n";
+
+    for (const Segment& segment : segments)
+        content += std::to_string(segment.Generation) + " " + std::to_string(segment.Level) + "\n";
+
+    // written next to the list and renamed over it, readers see the old or the new list
+    std::string temporary = _segmentPath + "." + std::to_string(getpid());
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+        throw HighscoreLoaderException("Failed to create the highscore segment list!");
+
+    bool written = WriteAll(fd, content.data(), content.size()) && fsync(fd) == 0;
+
+    if (close(fd) != 0 || !written || std::rename(temporary.c_str(), _segmentPath.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        throw HighscoreLoaderException("Failed to write the highscore segment list!");
+    }
+
+    // both renames reach the disk before the compacted score file is removed
+    if (!SyncDirectory(_segmentPath))
+        throw HighscoreLoaderException("Failed to flush the highscore directory!");
+}
+
+void HighscoreLoader::WriteSegment(const Segment& segment, const std::vector<Highscore>& pending, const std::vector<Segment>& merged) const
+{
+    // sorted entries of a merged segment
+    struct Source
+    {
+        const char* Cursor;
+        const char* End;
+        Highscore Score;
+        bool Valid;
+    };
+
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<Source> sources;
+
+    for (const Segment& input : merged)
+    {
+        files.emplace_back(new MappedFile(GetSegmentPath(input)));
+
+        const char* data = (const char*)files.back()->GetData();
+        const char* summary;
+        const char* trailer;
+
+        if (!files.back()->IsOpen() || !FindSummary(data, files.back()->GetSize(), summary, trailer))
+            throw HighscoreLoaderException("Failed to read the highscore segment!");
+
+        sources.push_back({ data, summary, Highscore(), false });
+    }
+
+    auto advance = [](Source& source)
+    {
+        source.Valid = false;
+
+        while (!source.Valid && source.Cursor < source.End)
+        {
+            const char* lineEnd = (const char*)std::memchr(source.Cursor, '\n', source.End - source.Cursor);
+            lineEnd = lineEnd != nullptr ? lineEnd : source.End;
+
+            source.Valid = ParseEntry(source.Cursor, lineEnd, source.Score.Map, source.Score.Score, source.Score.Lives, source.Score.Player);
+            source.Cursor = lineEnd < source.End ? lineEnd + 1 : source.End;
+        }
+    };
+
+    std::string path = GetSegmentPath(segment);
+    std::string temporary = path + "." + std::to_string(getpid());
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+        throw HighscoreLoaderException("Failed to create the highscore segment!");
 
     std::string buffer;
-    while (std::getline(ifs, buffer) && !buffer.empty())
+    std::string summary;
+    std::string map;
+    size_t ranked = 0;
+    uint64_t offset = 0;
+    bool written = true;
+
+    // every entry is kept, the generation of the list already guards the score file against a second merge
+    auto emit = [&](const Highscore& entry)
     {
-        std::istringstream iss(buffer, std::ios::in);
+        std::string line = Format(entry);
 
-        if (!(iss >> map >> score >> lives >> player) || iss.peek() != -1)
-            throw HighscoreLoaderException("Invalid number of arguments for entry!");
+        if (entry.Map != map)
+        {
+            map = entry.Map;
+            ranked = 0;
+        }
 
-        if (map != mapFilter)
-            continue;
+        // the best scores come first for every map, the summary repeats them
+        if (ranked++ < TOP_SCORES)
+            summary += line;
+
+        buffer += line;
 
-        _scores.push_back({ score, lives, map, player });
+        if (buffer.size() >= WRITE_BUFFER)
+        {
+            written = written && WriteAll(fd, buffer.data(), buffer.size());
+            offset += buffer.size();
+            buffer.clear();
+        }
+    };
+
+    for (Source& source : sources)
+        advance(source);
+
+    size_t next = 0;
+
+    while (true)
+    {
+        Source* best = nullptr;
+
+        for (Source& source : sources)
+        {
+            if (source.Valid && (best == nullptr || IsBefore(source.Score, best->Score)))
+                best = &source;
+        }
+
+        if (next < pending.size() && (best == nullptr || !IsBefore(best->Score, pending[next])))
+            emit(pending[next++]);
+        else if (best != nullptr)
+        {
+            emit(best->Score);
+            advance(*best);
+        }
+        else
+            break;
     }
 
-    std::sort(_scores.begin(), _scores.end(), [](Highscore l, Highscore r) -> bool { return l.Score == r.Score ? l.Lives > r.Lives : l.Score > r.Score; });
+    offset += buffer.size();
+    buffer += summary + SUMMARY_HEADER + " " + std::to_string(offset) + "\n";
+    written = written && WriteAll(fd, buffer.data(), buffer.size()) && fsync(fd) == 0;
+
+    if (close(fd) != 0 || !written || std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        throw HighscoreLoaderException("Failed to write the highscore segment!");
+    }
 }
 
-void HighscoreLoader::PrintHighscore(std::ostream& os) const
+void HighscoreLoader::RemoveStale(const std::vector<Segment>& segments) const
+{
+    std::string directory;
+    std::string prefix;
+    SplitPath(_segmentPath, directory, prefix);
+    prefix += ".";
+
+    std::vector<std::string> live;
+    for (const Segment& segment : segments)
+    {
+        std::string name;
+        SplitPath(GetSegmentPath(segment), directory, name);
+        live.push_back(name);
+    }
+
+    DIR* dir = opendir(directory.c_str());
+
+    if (dir == nullptr)
+        return;
+
+    // readers that still map a removed segment keep reading their copy, the ones that didn't open it yet read the new list
+    for (dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+
+        if (name.compare(0, prefix.size(), prefix) == 0 && std::find(live.begin(), live.end(), name) == live.end())
+            unlink((directory + "/" + name).c_str());
+    }
+
+    closedir(dir);
+}
+
+bool HighscoreLoader::MergeSummaries(const std::vector<Segment>& segments)
 {
-    for (size_t i = 0; i < _scores.size(); ++i)
-        os << _scores[i].Score << "\t" << _scores[i].Lives << "\t" << _scores[i].Player << std::endl;
+    for (const Segment& segment : segments)
+    {
+        MappedFile file(GetSegmentPath(segment));
+        const char* summary;
+        const char* trailer;
+
+        if (!file.IsOpen())
+            return false;
+
+        if (!FindSummary((const char*)file.GetData(), file.GetSize(), summary, trailer))
+            throw HighscoreLoaderException("Invalid highscore segment!");
+
+        // the index only keeps the best scores, the rest of the segment isn't touched
+        Merge(summary, trailer);
+    }
+
+    return true;
 }
 
-void HighscoreLoader::AppendHighscore(const Highscore& score)
+bool HighscoreLoader::FindSummary(const char* data, size_t size, const char*& summary, const char*& trailer)
+{
+    if (data == nullptr || size == 0 || data[size - 1] != '\n')
+        return false;
+
+    // the trailer is the last line
+    const char* end = data + size - 1;
+    const char* first = end;
+
+    while (first > data && first[-1] != '\n')
+        --first;
+
+    std::string line(first, end);
+    uint64_t offset;
+    char tail;
+
+    if (std::sscanf(line.c_str(), (SUMMARY_HEADER + " %" SCNu64 " %c").c_str(), &offset, &tail) != 1)
+        return false;
+
+    if (offset > (uint64_t)(first - data) || (offset > 0 && data[offset - 1] != '\n'))
+        return false;
+
+    summary = data + offset;
+    trailer = first;
+    return true;
+}
+
+bool HighscoreLoader::IsBefore(const Highscore& l, const Highscore& r)
+{
+    if (l.Map != r.Map)
+        return l.Map < r.Map;
+    if (l.Score != r.Score || l.Lives != r.Lives)
+        return IsBetter(l, r);
+    return l.Player < r.Player;
+}
+
+std::string HighscoreLoader::Format(const Highscore& score)
+{
+    return score.Map + "\t" + std::to_string(score.Score) + "\t" + std::to_string(score.Lives) + "\t" + score.Player + "\n";
+}
+
+void HighscoreLoader::ReadIndex()
+{
+    _index.clear();
+    _generation = 0;
+    _inode = 0;
+    _offset = 0;
+    _fingerprint = Fingerprint(nullptr, 0);
+
+    MappedFile file(_indexPath);
+
+    if (!file.IsOpen() || file.GetSize() == 0)
+        return;
+
+    const char* data = (const char*)file.GetData();
+    const char* end = data + file.GetSize();
+    const char* lineEnd = (const char*)std::memchr(data, '\n', end - data);
+
+    if (lineEnd == nullptr)
+        return;
+
+    std::string header(data, lineEnd);
+    uint64_t generation;
+    uint64_t inode;
+    uint64_t offset;
+    uint64_t fingerprint;
+    char tail;
+
+    if (std::sscanf(header.c_str(), (INDEX_HEADER + " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %c").c_str(), &generation, &inode, &offset, &fingerprint, &tail) != 4)
+        return;
+
+    int32_t score;
+    int32_t lives;
+    std::string map;
+    std::string player;
+
+    for (const char* cursor = lineEnd + 1; cursor < end; cursor = lineEnd + 1)
+    {
+        lineEnd = (const char*)std::memchr(cursor, '\n', end - cursor);
+
+        // invalid index is thrown away and rebuilt from the score file
+        if (lineEnd == nullptr || !ParseEntry(cursor, lineEnd, map, score, lives, player))
+        {
+            _index.clear();
+            return;
+        }
+
+        Insert(map, score, lives, player);
+    }
+
+    _generation = generation;
+    _inode = inode;
+    _offset = offset;
+    _fingerprint = fingerprint;
+}
+
+void HighscoreLoader::WriteIndex() const
+{
+    // written next to the index and renamed over it, readers see the old or the new index
+    std::string temporary = _indexPath + "." + std::to_string(getpid());
+
+    {
+        std::ofstream ofs(temporary, std::ios::out | std::ios::trunc);
+
+        if (ofs.fail())
+            throw HighscoreLoaderException("Failed to create the highscore index!");
+
+        ofs << INDEX_HEADER << " " << _generation << " " << _inode << " " << _offset << " " << _fingerprint << "\n";
+
+        for (const auto& entry : _index) for (const Highscore& score : entry.second)
+            ofs << Format(score);
+
+        if (!ofs.flush())
+        {
+            std::remove(temporary.c_str());
+            throw HighscoreLoaderException("Failed to write the highscore index!");
+        }
+    }
+
+    if (std::rename(temporary.c_str(), _indexPath.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        throw HighscoreLoaderException("Failed to write the highscore index!");
+    }
+}
+
+void HighscoreLoader::Insert(const std::string& map, int32_t score, int32_t lives, const std::string& player)
+{
+    std::vector<Highscore>& scores = _index[map];
+    Highscore entry = { score, lives, std::string(), std::string() };
+
+    // earlier scores stay in front of the equal later ones
+    auto position = std::upper_bound(scores.begin(), scores.end(), entry, IsBetter);
+    if (position - scores.begin() >= (ptrdiff_t)TOP_SCORES)
+        return;
+
+    entry.Map = map;
+    entry.Player = player;
+    scores.insert(position, std::move(entry));
+
+    if (scores.size() > TOP_SCORES)
+        scores.pop_back();
+}
+
+bool HighscoreLoader::ParseEntry(const char* first, const char* last, std::string& map, int32_t& score, int32_t& lives, std::string& player)
+{
+    const char* token;
+    size_t length;
+
+    if ((length = NextToken(first, last, token)) == 0)
+        return false;
+    map.assign(token, length);
+
+    if ((length = NextToken(first, last, token)) == 0 || !ParseNumber(token, length, score))
+        return false;
+
+    if ((length = NextToken(first, last, token)) == 0 || !ParseNumber(token, length, lives))
+        return false;
+
+    if ((length = NextToken(first, last, token)) == 0)
+        return false;
+    player.assign(token, length);
+
+    return NextToken(first, last, token) == 0;
+}
+
+uint64_t HighscoreLoader::Fingerprint(const char* data, uint64_t offset)
 {
-    std::ofstream ofs(_filePath, std::ios::out | std::ios::app);
+    uint64_t hash = FNV_OFFSET;
 
-    if (ofs.fail())
-        throw HighscoreLoaderException("Failed to initialize input file stream!");
+    for (uint64_t i = offset > FINGERPRINT_LENGTH ? offset - FINGERPRINT_LENGTH : 0; i < offset; ++i)
+        hash = (hash ^ (uint8_t)data[i]) * FNV_PRIME;
 
-    if (!(ofs << score.Map << "\t" << score.Score << "\t" << score.Lives << "\t" << score.Player << std::endl))
-        throw HighscoreLoaderException("Failed to append the highscore!");
+    return (hash ^ offset) * FNV_PRIME;
 }
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <cstdint>
 #include <fstream>
 #include <vector>
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <functional>
+#include <condition_variable>
 
 /**
  * @brief Class used for wrapping exception context from the HighscoreLoader class.
@@ -41,14 +49,45 @@ struct Highscore
 };
 
 /**
- * @brief Class used for loading and writing highscores.
+ * @brief Class used for loading and writing highscores. Scores are appended to the score file, the index file next to it keeps the best scores of every map.
+ * Large score files are compacted into immutable sorted segments merged in tiers, readers only take the best scores stored at the end of every segment.
+ * Several processes can append and compact the same score file.
+ * Asynchronous requests run in order on a worker thread, the synchronous methods can't be used while any of them is pending.
 */
 class HighscoreLoader
 {
 private:
+    static const size_t TOP_SCORES = 10;
+    static const size_t FINGERPRINT_LENGTH = 64;
+    static const uint64_t COMPACTION_SIZE = 1 << 20; // score file size that triggers the compaction
+    static const size_t TIER_FANOUT = 4; // segments of a level merged into one segment of the next level
+
+    /**
+     * @brief Structure used for identifying a segment file.
+    */
+    struct Segment
+    {
+        uint64_t Generation; // compaction that wrote the segment
+        uint32_t Level; // number of the tier merges, the segment holds about TIER_FANOUT^Level compacted score files
+    };
+
     std::string _filePath;
+    std::string _indexPath;
+    std::string _segmentPath;
+    bool _indexed;
+    uint64_t _generation; // compactions of the segment merged into the index
+    uint64_t _inode; // score file merged into the index
+    uint64_t _offset; // bytes of the score file merged into the index
+    uint64_t _fingerprint; // hash of the end of the merged part
+    std::unordered_map<std::string, std::vector<Highscore>> _index;
     std::vector<Highscore> _scores;
 
+    std::thread _worker;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<std::packaged_task<std::vector<Highscore>()>> _jobs;
+    bool _stopping;
+
 public:
     /**
      * @brief Create a new instance of the object.
@@ -56,19 +95,191 @@ public:
     */
     HighscoreLoader(const std::string& fileName);
     /**
-     * @brief Load the data.
+     * @brief Finish the pending requests and stop the worker before destroying a instance of the object.
+    */
+    ~HighscoreLoader();
+    HighscoreLoader(const HighscoreLoader&) = delete;
+    HighscoreLoader& operator=(const HighscoreLoader&) = delete;
+    /**
+     * @brief Load the data. Scores appended since the last load are merged into the index first.
      * @param map Map file path to filter highscores.
     */
     void Load(const std::string& map);
+    /**
+     * @brief Index file path getter.
+     * @return Value of the index file path.
+    */
+    std::string GetIndexPath() const;
+    /**
+     * @brief Highscores getter.
+     * @return Best scores of the loaded map in descending order.
+    */
+    const std::vector<Highscore>& GetHighscores() const;
     /**
      * @brief Print highscores in descending order.
      * @param os Output stream.
     */
     void PrintHighscore(std::ostream& os) const;
     /**
-     * @brief Append the score.
+     * @brief Append the score. The entry is written at once under a shared lock, compaction runs once the score file grows too large.
      * @param score New score to append.
     */
     void AppendHighscore(const Highscore& score);
-};
+    /**
+     * @brief Compact the score file into a new segment, full tiers of segments are merged into it. Appends continue to a new score file in the meantime.
+     * @return True if the compaction ran, false if another one is in progress.
+    */
+    bool Compact();
+    /**
+     * @brief Append the score and load the highscores of its map on the worker thread.
+     * @param score New score to append.
+     * @return Future with the best scores of the map, holds the HighscoreLoaderException on failure.
+    */
+    std::future<std::vector<Highscore>> AppendAsync(const Highscore& score);
+    /**
+     * @brief Load the highscores on the worker thread.
+     * @param map Map file path to filter highscores.
+     * @return Future with the best scores of the map, holds the HighscoreLoaderException on failure.
+    */
+    std::future<std::vector<Highscore>> LoadAsync(const std::string& map);
+    /**
+     * @brief Print highscores in descending order.
+     * @param os Output stream.
+     * @param scores Highscores to print.
+    */
+    static void PrintHighscore(std::ostream& os, const std::vector<Highscore>& scores);
+    /**
+     * @brief Compare the scores, higher score wins and more lives left break the tie.
+     * @param l First score.
+     * @param r Second score.
+     * @return True if the first score is better.
+    */
+    static bool IsBetter(const Highscore& l, const Highscore& r);
 
+private:
+    /**
+     * @brief Queue the job for the worker thread, the worker is started with the first job.
+     * @param job Job to run.
+     * @return Future with the result of the job.
+    */
+    std::future<std::vector<Highscore>> Submit(std::function<std::vector<Highscore>()> job);
+    /**
+     * @brief Run the queued jobs until the object is destroyed.
+    */
+    void Work();
+    /**
+     * @brief Merge the scores appended since the last refresh into the index and save the index. Compacted scores are merged from the segment summaries after every compaction.
+    */
+    void Refresh();
+    /**
+     * @brief Insert the entries of the data to the index.
+     * @param cursor First character of the data.
+     * @param end End of the data.
+     * @return End of the last complete line, torn entries are skipped.
+    */
+    const char* Merge(const char* cursor, const char* end);
+    /**
+     * @brief Open the score file for appending and lock it. Score file renamed by a compaction before the lock is reopened.
+     * @param operation Lock operation.
+     * @return File descriptor.
+    */
+    int OpenLocked(int operation) const;
+    /**
+     * @brief Pending file path getter. Holds the score file taken by the compaction of the generation.
+     * @param generation Generation of the compaction.
+     * @return Value of the pending file path.
+    */
+    std::string GetPendingPath(uint64_t generation) const;
+    /**
+     * @brief Segment file path getter.
+     * @param segment Segment to locate.
+     * @return Value of the segment file path.
+    */
+    std::string GetSegmentPath(const Segment& segment) const;
+    /**
+     * @brief Read the list of the live segments.
+     * @param segments Output segments, from the oldest to the newest.
+     * @return Generation of the last compaction, zero for a missing list.
+    */
+    uint64_t ReadManifest(std::vector<Segment>& segments) const;
+    /**
+     * @brief Atomically replace the list of the live segments and flush it to the disk together with the new segment.
+     * @param generation Generation of the compaction.
+     * @param segments Live segments, from the oldest to the newest.
+    */
+    void WriteManifest(uint64_t generation, const std::vector<Segment>& segments) const;
+    /**
+     * @brief Write the new segment and flush it to the disk. The inputs are merged in a single pass.
+     * @param segment Segment to write.
+     * @param pending Sorted entries of the compacted score file.
+     * @param merged Segments merged into the new one.
+    */
+    void WriteSegment(const Segment& segment, const std::vector<Highscore>& pending, const std::vector<Segment>& merged) const;
+    /**
+     * @brief Remove the segment files that aren't in the list - merged segments and leftovers of interrupted compactions.
+     * @param segments Live segments.
+    */
+    void RemoveStale(const std::vector<Segment>& segments) const;
+    /**
+     * @brief Insert the best scores of the segments to the index.
+     * @param segments Segments to merge.
+     * @return False if a segment was removed by a compaction in the meantime.
+    */
+    bool MergeSummaries(const std::vector<Segment>& segments);
+    /**
+     * @brief Locate the best scores of every map at the end of the segment.
+     * @param data Content of the segment file.
+     * @param size Size of the content.
+     * @param summary Output first line of the best scores, the sorted entries end there.
+     * @param trailer Output end of the best scores.
+     * @return True if the segment is well formed.
+    */
+    static bool FindSummary(const char* data, size_t size, const char*& summary, const char*& trailer);
+    /**
+     * @brief Order of the compacted entries - map, then the best scores first.
+     * @param l First entry.
+     * @param r Second entry.
+     * @return True if the first entry goes first.
+    */
+    static bool IsBefore(const Highscore& l, const Highscore& r);
+    /**
+     * @brief Format the entry as a line of the score file.
+     * @param score Entry to format.
+     * @return Line with the line break.
+    */
+    static std::string Format(const Highscore& score);
+    /**
+     * @brief Read the index file. Missing or invalid index starts empty.
+    */
+    void ReadIndex();
+    /**
+     * @brief Atomically replace the index file.
+    */
+    void WriteIndex() const;
+    /**
+     * @brief Insert the score to the best scores of its map.
+     * @param map Map file path.
+     * @param score Score.
+     * @param lives Lives left.
+     * @param player Player's name.
+    */
+    void Insert(const std::string& map, int32_t score, int32_t lives, const std::string& player);
+    /**
+     * @brief Parse a line of the score file.
+     * @param first First character of the line.
+     * @param last End of the line.
+     * @param map Output map file path.
+     * @param score Output score.
+     * @param lives Output lives left.
+     * @param player Output player's name.
+     * @return True if the line is a valid entry.
+    */
+    static bool ParseEntry(const char* first, const char* last, std::string& map, int32_t& score, int32_t& lives, std::string& player);
+    /**
+     * @brief Hash the end of the merged part of the score file, detects a replaced score file.
+     * @param data Content of the score file.
+     * @param offset End of the merged part.
+     * @return Hash of the bytes before the offset.
+    */
+    static uint64_t Fingerprint(const char* data, uint64_t offset);
+};
@@ -1,83 +1,126 @@
 #include "InputHandler.h"
 
 InputHandler::InputHandler()
-    : State(State::STALE)
+    : State(State::STALE), TargetsReset(false), _time(0), _started(false)
 {
     for (size_t i = 0; i < KEYS_COUNT; ++i)
+    {
         KeyMap[i] = false;
+        Held[i] = 0;
+        _down[i] = false;
+    }
 }
 
 void InputHandler::Process()
 {
     SDL_Event event;
-    SDL_PollEvent(&event);
 
-    switch (event.type)
+    // drain the whole queue, a burst of events would otherwise lag behind by frames
+    while (SDL_PollEvent(&event))
     {
-    case SDL_QUIT:
-        State = State::QUIT;
-        break;
-    case SDL_KEYDOWN:
-        ProcessKeyDown(event.key.keysym.sym);
-        break;
-    case SDL_KEYUP:
-        ProcessKeyUp(event.key.keysym.sym);
-        break;
-    default:
-        break;
+        switch (event.type)
+        {
+        case SDL_QUIT:
+            State = State::QUIT;
+            break;
+        case SDL_RENDER_TARGETS_RESET:
+        case SDL_RENDER_DEVICE_RESET:
+            TargetsReset = true;
+            break;
+        case SDL_KEYDOWN:
+            ProcessKey(event.key, true);
+            break;
+        case SDL_KEYUP:
+            ProcessKey(event.key, false);
+            break;
+        default:
+            break;
+        }
     }
 }
 
-void InputHandler::ProcessKeyUp(const SDL_Keycode& keyCode)
+void InputHandler::Advance(uint32_t time)
 {
-    switch (keyCode)
+    uint32_t start = _started ? _time : time;
+    uint32_t last = start;
+    uint32_t held[KEYS_COUNT] = { 0 };
+
+    Applied.clear();
+
+    for (size_t i = 0; i < KEYS_COUNT; ++i)
+        KeyMap[i] = _down[i];
+
+    // transitions after the end of the tick wait for the next one
+    while (!_events.empty() && !IsBefore(time, _events.front().Time))
     {
-    case SDLK_LEFT:
-        KeyMap[KEY_LEFT_ARROW] = false;
-        break;
-    case SDLK_RIGHT:
-        KeyMap[KEY_RIGHT_ARROW] = false;
-        break;
-    case SDLK_UP:
-        KeyMap[KEY_UP_ARROW] = false;
-        break;
-    case SDLK_DOWN:
-        KeyMap[KEY_DOWN_ARROW] = false;
-        break;
-    case SDLK_SPACE:
-        KeyMap[KEY_SPACE] = false;
-        break;
-    case SDLK_ESCAPE:
-        KeyMap[KEY_ESCAPE] = false;
-        break;
-    default:
-        break;
+        const KeyEvent& event = _events.front();
+
+        // late transitions are applied at the start of the tick
+        uint32_t at = IsBefore(event.Time, start) ? start : event.Time;
+
+        for (size_t i = 0; i < KEYS_COUNT; ++i)
+            held[i] += _down[i] ? at - last : 0;
+
+        last = at;
+        _down[event.Key] = event.Down;
+        KeyMap[event.Key] |= event.Down;
+
+        if (event.Key == KEY_LEFT_ARROW || event.Key == KEY_RIGHT_ARROW)
+            Applied.push_back(event.Time);
+
+        _events.pop_front();
+    }
+
+    uint32_t length = time - start;
+
+    for (size_t i = 0; i < KEYS_COUNT; ++i)
+    {
+        held[i] += _down[i] ? time - last : 0;
+        Held[i] = length == 0 ? (_down[i] ? HELD_STEPS : 0) : (int32_t)((held[i] * HELD_STEPS + length / 2) / length);
     }
+
+    _time = time;
+    _started = true;
+}
+
+void InputHandler::Set(int32_t key, bool down)
+{
+    KeyMap[key] = down;
+    Held[key] = down ? HELD_STEPS : 0;
 }
 
-void InputHandler::ProcessKeyDown(const SDL_Keycode& keyCode)
+void InputHandler::ProcessKey(const SDL_KeyboardEvent& event, bool down)
 {
-    switch (keyCode)
+    int32_t key;
+
+    switch (event.keysym.sym)
     {
     case SDLK_LEFT:
-        KeyMap[KEY_LEFT_ARROW] = true;
+        key = KEY_LEFT_ARROW;
         break;
     case SDLK_RIGHT:
-        KeyMap[KEY_RIGHT_ARROW] = true;
+        key = KEY_RIGHT_ARROW;
         break;
     case SDLK_UP:
-        KeyMap[KEY_UP_ARROW] = true;
+        key = KEY_UP_ARROW;
         break;
     case SDLK_DOWN:
-        KeyMap[KEY_DOWN_ARROW] = true;
+        key = KEY_DOWN_ARROW;
         break;
     case SDLK_SPACE:
-        KeyMap[KEY_SPACE] = true;
+        key = KEY_SPACE;
         break;
     case SDLK_ESCAPE:
-        KeyMap[KEY_ESCAPE] = true;
+        key = KEY_ESCAPE;
         break;
     default:
-        break;
+        return;
     }
+
+    _events.push_back({ event.timestamp, key, down });
+}
+
+bool InputHandler::IsBefore(uint32_t l, uint32_t r)
+{
+    return (int32_t)(l - r) < 0;
 }
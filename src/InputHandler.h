@@ -1,6 +1,9 @@
 #pragma once
 
 #include <SDL2/SDL.h>
+#include <cstdint>
+#include <deque>
+#include <vector>
 
 /**
  * @brief Class used for handling SDL inputs and events.
@@ -13,7 +16,27 @@ public:
     */
     enum class State { STALE, QUIT } State;
     enum { KEY_LEFT_ARROW, KEY_RIGHT_ARROW, KEY_UP_ARROW, KEY_DOWN_ARROW, KEY_SPACE, KEY_ESCAPE, KEYS_COUNT };
-    bool KeyMap[KEYS_COUNT];
+    static const int32_t HELD_STEPS = 16;
+    bool KeyMap[KEYS_COUNT]; // key was down at some point of the tick
+    int32_t Held[KEYS_COUNT]; // part of the tick the key was down, in HELD_STEPS
+    std::vector<uint32_t> Applied; // timestamps of the arrow transitions applied by the last tick
+    bool TargetsReset; // render targets were lost
+
+private:
+    /**
+     * @brief Structure used for storing a timestamped key transition.
+    */
+    struct KeyEvent
+    {
+        uint32_t Time;
+        int32_t Key;
+        bool Down;
+    };
+
+    std::deque<KeyEvent> _events;
+    bool _down[KEYS_COUNT];
+    uint32_t _time; // end of the last tick
+    bool _started;
 
 public:
     /**
@@ -21,20 +44,33 @@ public:
     */
     InputHandler();
     /**
-     * @brief Process events and inputs.
+     * @brief Process all pending events. Key transitions are queued with their timestamps until a tick covering them is advanced.
     */
     void Process();
+    /**
+     * @brief Apply the queued key transitions up to the end of a tick and update the key states of the tick.
+     * @param time Event time of the end of the tick in milliseconds, the tick starts where the previous one ended.
+    */
+    void Advance(uint32_t time);
+    /**
+     * @brief Key state setter, the key is held for the whole tick or not at all.
+     * @param key Index of the key.
+     * @param down Key state.
+    */
+    void Set(int32_t key, bool down);
 
 private:
     /**
-     * @brief Process releasing a key.
-     * @param keyCode Code of a released key.
+     * @brief Queue a key transition.
+     * @param event Keyboard event.
+     * @param down Pressed flag.
     */
-    void ProcessKeyUp(const SDL_Keycode& keyCode);
+    void ProcessKey(const SDL_KeyboardEvent& event, bool down);
     /**
-     * @brief Process pressing a key.
-     * @param keyCode Code of a pressed key.
+     * @brief Check if the time is before the other, tolerates the wrap around of the timestamps.
+     * @param l First time.
+     * @param r Second time.
+     * @return True if the first time is before the second one.
     */
-    void ProcessKeyDown(const SDL_Keycode& keyCode);
+    static bool IsBefore(uint32_t l, uint32_t r);
 };
-
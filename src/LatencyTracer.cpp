@@ -0,0 +1,111 @@
+#include "LatencyTracer.h"
+
+#include <cmath>
+#include <algorithm>
+
+static const char* STAGE_NAMES[] = { "ProcessEvents", "Update", "Present" };
+
+LatencyTracer::LatencyTracer(bool enabled)
+    : _enabled(enabled)
+{
+    for (int32_t i = 0; i < STAGE_COUNT; ++i)
+        _histograms[i].resize(_enabled ? BUCKETS : (size_t)0);
+}
+
+bool LatencyTracer::IsEnabled() const
+{
+    return _enabled;
+}
+
+void LatencyTracer::Process(const std::vector<uint32_t>& events)
+{
+    if (!_enabled || events.empty())
+        return;
+
+    Record(PROCESS, events, SDL_GetTicks());
+    _processed.insert(_processed.end(), events.begin(), events.end());
+}
+
+void LatencyTracer::Update()
+{
+    if (!_enabled || _processed.empty())
+        return;
+
+    Record(UPDATE, _processed, SDL_GetTicks());
+    _updated.insert(_updated.end(), _processed.begin(), _processed.end());
+    _processed.clear();
+}
+
+void LatencyTracer::Present()
+{
+    if (!_enabled || _updated.empty())
+        return;
+
+    Record(PRESENT, _updated, SDL_GetTicks());
+    _updated.clear();
+}
+
+uint64_t LatencyTracer::GetCount(Stage stage) const
+{
+    uint64_t count = 0;
+
+    for (uint64_t bucket : _histograms[stage])
+        count += bucket;
+
+    return count;
+}
+
+uint32_t LatencyTracer::Percentile(Stage stage, double percentile) const
+{
+    uint64_t count = GetCount(stage);
+
+    if (count == 0)
+        return 0;
+
+    uint64_t rank = std::max((uint64_t)std::ceil(percentile / 100.0 * count), (uint64_t)1);
+
+    for (size_t i = 0; i < _histograms[stage].size(); ++i)
+    {
+        if (_histograms[stage][i] >= rank)
+            return (uint32_t)i;
+
+        rank -= _histograms[stage][i];
+    }
+
+    return (uint32_t)BUCKETS - 1;
+}
+
+void LatencyTracer::PrintSummary(std::ostream& os, const std::string& renderer) const
+{
+    if (!_enabled)
+        return;
+
+    os << "Input latency on " << renderer << ", " << GetCount(PRESENT) << " events traced." << std::endl;
+    os << "stage\tp50 ms\tp95 ms\tp99 ms\tmax ms" << std::endl;
+
+    for (int32_t i = 0; i < STAGE_COUNT; ++i)
+        os << STAGE_NAMES[i] << "\t" << Percentile((Stage)i, 50) << "\t" << Percentile((Stage)i, 95) << "\t" << Percentile((Stage)i, 99) << "\t" << Percentile((Stage)i, 100) << std::endl;
+
+    const std::vector<uint64_t>& histogram = _histograms[PRESENT];
+    uint64_t peak = *std::max_element(histogram.begin(), histogram.end());
+
+    if (peak == 0)
+        return;
+
+    // only the buckets between the first and the last hit are printed
+    size_t first = std::find_if(histogram.begin(), histogram.end(), [](uint64_t bucket) { return bucket != 0; }) - histogram.begin();
+    size_t last = histogram.rend() - std::find_if(histogram.rbegin(), histogram.rend(), [](uint64_t bucket) { return bucket != 0; });
+
+    for (size_t i = first; i < last; ++i)
+        os << (i + 1 == BUCKETS ? ">=" : "") << i << " ms\t" << std::string((size_t)(histogram[i] * BAR_WIDTH / peak), '#') << " " << histogram[i] << std::endl;
+}
+
+void LatencyTracer::Record(Stage stage, const std::vector<uint32_t>& events, uint32_t time)
+{
+    for (uint32_t event : events)
+    {
+        // timestamps can't be ahead of the clock, clamped just in case
+        int32_t latency = std::max((int32_t)(time - event), 0);
+        ++_histograms[stage][std::min((size_t)latency, BUCKETS - 1)];
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Class used for tracing the latency of the platform inputs. Every arrow transition is followed from its SDL timestamp
+ * through the tick that applies it and the update that moves the platform to the first present that shows the result.
+*/
+class LatencyTracer
+{
+public:
+    /**
+     * @brief Enum for the traced stages, each measured from the event timestamp.
+    */
+    enum Stage { PROCESS, UPDATE, PRESENT, STAGE_COUNT };
+
+private:
+    static const size_t BUCKETS = 256; // 1 ms each, the last one collects the rest
+    static const int32_t BAR_WIDTH = 40;
+
+    bool _enabled;
+    std::vector<uint32_t> _processed; // timestamps waiting for the end of the update
+    std::vector<uint32_t> _updated; // timestamps waiting for the present
+    std::vector<uint64_t> _histograms[STAGE_COUNT];
+
+public:
+    /**
+     * @brief Create a new instance of the object.
+     * @param enabled Enabled flag. Disabled tracer records nothing.
+    */
+    LatencyTracer(bool enabled);
+
+    /**
+     * @brief Enabled flag getter.
+     * @return True if tracing.
+    */
+    bool IsEnabled() const;
+    /**
+     * @brief Mark the events applied by the current tick.
+     * @param events Timestamps of the applied events.
+    */
+    void Process(const std::vector<uint32_t>& events);
+    /**
+     * @brief Mark the end of the update that moved the platform by the processed events.
+    */
+    void Update();
+    /**
+     * @brief Mark the end of the present showing the updated events.
+    */
+    void Present();
+    /**
+     * @brief Number of traced events getter.
+     * @param stage Traced stage.
+     * @return Number of the events that reached the stage.
+    */
+    uint64_t GetCount(Stage stage) const;
+    /**
+     * @brief Calculate a percentile of the recorded latencies.
+     * @param stage Traced stage.
+     * @param percentile Percentile in range 0 to 100.
+     * @return Latency in milliseconds, the last bucket is reported as its lower bound.
+    */
+    uint32_t Percentile(Stage stage, double percentile) const;
+    /**
+     * @brief Print percentiles of all stages and the histogram of the input to present latency.
+     * @param os Output stream.
+     * @param renderer Description of the renderer configuration.
+    */
+    void PrintSummary(std::ostream& os, const std::string& renderer) const;
+
+private:
+    /**
+     * @brief Record the latencies of the events reaching a stage.
+     * @param stage Reached stage.
+     * @param events Timestamps of the events.
+     * @param time Time the stage was reached.
+    */
+    void Record(Stage stage, const std::vector<uint32_t>& events, uint32_t time);
+};
@@ -1,7 +1,15 @@
-#include "Game.h"
+#include "BatchRunner.h"
 
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
 #include <cassert>
+#include <fstream>
+#include <sstream>
 #include <iostream>
+#include <algorithm>
+
+#include <unistd.h>
 
 bool test_map(std::string fileName)
 {
@@ -9,7 +17,8 @@ bool test_map(std::string fileName)
 
     try
     {
-        mapTester.Load();
+        // bypass the compiled maps, the text parser is tested and nothing is written next to the maps
+        mapTester.Load(false);
     }
     catch (const MapLoaderException& e)
     {
@@ -19,26 +28,268 @@ bool test_map(std::string fileName)
     return true;
 }
 
+std::string test_map_error(std::string fileName)
+{
+    MapLoader mapTester(fileName, 10, 8);
+
+    try
+    {
+        mapTester.Load(false);
+    }
+    catch (const MapLoaderException& e)
+    {
+        return e.Message();
+    }
+
+    return std::string();
+}
+
+bool same_map(const Map& l, const Map& r)
+{
+    if (l.GetRows() != r.GetRows() || l.GetColumns() != r.GetColumns())
+        return false;
+
+    for (int32_t i = 0; i < l.GetRows(); ++i) for (int32_t j = 0; j < l.GetColumns(); ++j)
+    {
+        if (l.Get(i, j) != r.Get(i, j))
+            return false;
+    }
+
+    return true;
+}
+
+void patch_file(const std::string& path, std::streamoff offset, std::ios::seekdir origin, char value)
+{
+    std::fstream fs(path, std::ios::in | std::ios::out | std::ios::binary);
+    fs.seekp(offset, origin);
+    fs.put(value);
+}
+
+bool test_compiled_map(std::string fileName)
+{
+    // private copy of the map, the compiled map is written next to it
+    char directory[] = "/tmp/pupaldom-XXXXXX";
+    if (mkdtemp(directory) == nullptr)
+        return false;
+
+    std::string copy = std::string(directory) + "/Map.txt";
+    std::string compiled = MapLoader::GetCompiledPath(copy);
+    {
+        std::ifstream ifs(fileName, std::ios::binary);
+        std::ofstream ofs(copy, std::ios::binary);
+        ofs << ifs.rdbuf();
+    }
+
+    bool passed = false;
+
+    try
+    {
+        MapLoader mapTester(copy, 10, 8);
+        Map parsed = mapTester.Load(true);
+        Map cached = mapTester.Load(true);
+
+        // the compiled map of the unchanged text is used as it is
+        patch_file(compiled, -1, std::ios::end, 5);
+        Map patched = mapTester.Load(true);
+
+        // a cell out of the range of the text format rejects the compiled map, the text is parsed again
+        patch_file(compiled, -1, std::ios::end, 0x7F);
+        Map recovered = mapTester.Load(true);
+
+        // changed text doesn't match the hash of the compiled map, the compiled map is refreshed
+        patch_file(copy, 0, std::ios::beg, '2');
+        Map edited = mapTester.Load(true);
+        Map refreshed = mapTester.Load(true);
+
+        passed = same_map(parsed, cached) && patched.Get(patched.GetRows() - 1, patched.GetColumns() - 1) == 5 && same_map(parsed, recovered)
+            && edited.Get(0, 0) == 2 && same_map(edited, refreshed);
+    }
+    catch (const MapLoaderException& e) { }
+
+    std::remove(compiled.c_str());
+    std::remove(copy.c_str());
+    rmdir(directory);
+    return passed;
+}
+
+bool test_replay()
+{
+    char directory[] = "/tmp/pupaldom-XXXXXX";
+    if (mkdtemp(directory) == nullptr)
+        return false;
+
+    std::string path = std::string(directory) + "/Replay.rvrp";
+
+    // runs longer than 127 ticks take several bytes of the length
+    const uint64_t lengths[] = { 1, 127, 128, 300, 20000 };
+    const size_t runs = sizeof(lengths) / sizeof(lengths[0]);
+    bool passed = false;
+
+    auto apply = [](InputHandler& input, size_t run)
+    {
+        input.Set(InputHandler::KEY_LEFT_ARROW, run % 2 == 0);
+        input.Set(InputHandler::KEY_RIGHT_ARROW, run % 2 == 1);
+        input.Set(InputHandler::KEY_SPACE, run == 3);
+        input.Held[InputHandler::KEY_LEFT_ARROW] = run % 2 == 0 ? (int32_t)run + 5 : 0;
+    };
+
+    try
+    {
+        Replay recording(42, "examples/maps/Map1.txt");
+        InputHandler input;
+
+        for (size_t i = 0; i < runs; ++i) for (uint64_t j = 0; j < lengths[i]; ++j)
+        {
+            apply(input, i);
+            recording.Record(input);
+        }
+
+        recording.Save(path, 1234);
+
+        Replay playback = Replay::Load(path);
+        InputHandler expected;
+        passed = playback.GetSeed() == 42 && playback.GetScore() == 1234 && playback.GetTicks() == recording.GetTicks() && playback.GetMapPath() == "examples/maps/Map1.txt";
+
+        for (size_t i = 0; i < runs; ++i) for (uint64_t j = 0; j < lengths[i] && passed; ++j)
+        {
+            apply(expected, i);
+            passed = playback.Next(input) && std::equal(input.KeyMap, input.KeyMap + InputHandler::KEYS_COUNT, expected.KeyMap)
+                && std::equal(input.Held, input.Held + InputHandler::KEYS_COUNT, expected.Held);
+        }
+
+        passed = passed && !playback.Next(input);
+
+        // map path length of a corrupted header is rejected before allocating
+        for (std::streamoff i = 0; i < 4; ++i)
+            patch_file(path, 28 + i, std::ios::beg, (char)0xFF);
+
+        try
+        {
+            Replay::Load(path);
+            passed = false;
+        }
+        catch (const ReplayException& e) { }
+    }
+    catch (const ReplayException& e)
+    {
+        passed = false;
+    }
+
+    std::remove(path.c_str());
+    rmdir(directory);
+    return passed;
+}
+
 int main(int argc, char* argv[])
 {
     static const std::string DEFAULT_PLAYER_NAME = "Anonymous";
     static const std::string DEFAULT_MAP_FILE_PATH = "examples/maps/Map4.txt";
     static const std::string DEFAULT_SCORE_FILE_PATH = "examples/Score.txt";
 
-    if (argc > 3)
+    GameSettings settings = { false, false, false, false, (uint32_t)time(0) };
+    uint32_t batch = 0;
+    uint32_t threads = 0;
+    std::vector<std::string> arguments;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+
+        if (argument == "--headless") settings.Headless = true;
+        else if (argument == "--profile") settings.Profile = true;
+        else if (argument == "--profile-csv" && i + 1 < argc) settings.ProfileCsv = argv[++i];
+        else if (argument == "--profile-trace" && i + 1 < argc) settings.ProfileTrace = argv[++i];
+        else if (argument == "--latency") settings.Latency = true;
+        else if (argument == "--seed" && i + 1 < argc)
+        {
+            try
+            {
+                settings.Seed = (uint32_t)std::stoul(argv[++i]);
+            }
+            catch (const std::logic_error& e)
+            {
+                std::cout << "Invalid seed " << argv[i] << "!" << std::endl;
+                return 1;
+            }
+        }
+        else if ((argument == "--batch" || argument == "--threads") && i + 1 < argc)
+        {
+            try
+            {
+                (argument == "--batch" ? batch : threads) = (uint32_t)std::stoul(argv[++i]);
+            }
+            catch (const std::logic_error& e)
+            {
+                std::cout << "Invalid number " << argv[i] << "!" << std::endl;
+                return 1;
+            }
+        }
+        else if (argument == "--renderer" && i + 1 < argc) settings.Render.Driver = argv[++i];
+        else if (argument == "--software") settings.Render.Software = true;
+        else if (argument == "--vsync") settings.Render.Vsync = true;
+        else if (argument == "--uncapped") settings.Uncapped = true;
+        else if (argument == "--fps" && i + 1 < argc)
+        {
+            try
+            {
+                settings.Fps = (uint32_t)std::stoul(argv[++i]);
+            }
+            catch (const std::logic_error& e)
+            {
+                std::cout << "Invalid number " << argv[i] << "!" << std::endl;
+                return 1;
+            }
+        }
+        else if (argument == "--window" && i + 1 < argc)
+        {
+            char separator = '\0';
+            std::istringstream iss(argv[++i]);
+
+            if (!(iss >> settings.Render.Width >> separator >> settings.Render.Height) || separator != 'x' || !iss.eof() || settings.Render.Width <= 0 || settings.Render.Height <= 0)
+            {
+                std::cout << "Invalid window size " << argv[i] << "!" << std::endl;
+                return 1;
+            }
+        }
+        else if (argument == "--record" && i + 1 < argc) settings.RecordPath = argv[++i];
+        else if (argument == "--replay" && i + 1 < argc)
+        {
+            try
+            {
+                settings.Playback = std::make_shared<Replay>(Replay::Load(argv[++i]));
+            }
+            catch (const ReplayException& e)
+            {
+                std::cout << e.Message() << std::endl;
+                return 1;
+            }
+        }
+        else if (argument.compare(0, 2, "--") == 0)
+        {
+            std::cout << "Unknown option " << argument << "!" << std::endl;
+            return 1;
+        }
+        else arguments.push_back(argument);
+    }
+
+    // exporting implies profiling
+    settings.Profile = settings.Profile || !settings.ProfileCsv.empty() || !settings.ProfileTrace.empty();
+
+    if (arguments.size() > 2)
     {
         std::cout << "Invalid number of arguments!" << std::endl;
         return 1;
     }
 
-    std::string map = argc > 1 ? argv[1] : DEFAULT_MAP_FILE_PATH;
-    std::string player = argc > 2 ? argv[2] : DEFAULT_PLAYER_NAME;
+    std::string map = arguments.size() > 0 ? arguments[0] : settings.Playback ? settings.Playback->GetMapPath() : DEFAULT_MAP_FILE_PATH;
+    std::string player = arguments.size() > 1 ? arguments[1] : DEFAULT_PLAYER_NAME;
 
     // test maploader
     assert(test_map("examples/maps/Map1.txt"));
     assert(test_map("examples/maps/Map2.txt"));
     assert(test_map("examples/maps/Map3.txt"));
     assert(test_map("examples/maps/Map4.txt"));
+    assert(test_map("examples/maps/Map5.txt"));
     assert(test_map("examples/maps/EasyMap0.txt"));
     assert(test_map("examples/maps/EasyMap1.txt"));
     assert(test_map("examples/maps/HardMap0.txt"));
@@ -46,10 +297,42 @@ int main(int argc, char* argv[])
     assert(!test_map("examples/maps/BadMap0.txt"));
     assert(!test_map("examples/maps/BadMap1.txt"));
     assert(!test_map("examples/maps/BadMap2.txt"));
+    assert(!test_map("examples/maps/BadMap3.txt"));
+    assert(!test_map("examples/maps/BadMap4.txt"));
+    assert(!test_map("examples/maps/BadMap5.txt"));
+
+    // parser errors point to the first invalid character - inside of a vectorized chunk, in the scalar tail, past the last row
+    assert(test_map_error("examples/maps/BadMap3.txt") == "Invalid map header at line 1, column 8!");
+    assert(test_map_error("examples/maps/BadMap5.txt") == "Invalid number of columns inside of a row at line 6, column 12!");
+    assert(test_map_error("examples/maps/BadMap6.txt") == "Invalid character at line 4, column 6!");
+    assert(test_map_error("examples/maps/BadMap7.txt") == "Invalid character at line 4, column 19!");
+    assert(test_map_error("examples/maps/BadMap8.txt") == "Invalid number of rows at line 10, column 1!");
+    assert(test_map_error("examples/maps/BadMap9.txt") == "Invalid number of rows at line 11, column 1!");
+
+    // compiled map cache on a copy of the map
+    assert(test_compiled_map("examples/maps/Map1.txt"));
+
+    // replay round trip
+    assert(test_replay());
+
+    // evaluate map
+    if (batch > 0)
+    {
+        BatchRunner runner(map, batch, threads, settings.Seed);
+
+        if (!runner.Run())
+            return 1;
+
+        runner.PrintReport(std::cout);
+        return 0;
+    }
 
     // run game
-    Game game(map, DEFAULT_SCORE_FILE_PATH, player);
-    game.Init();
+    Game game(map, DEFAULT_SCORE_FILE_PATH, player, settings);
+
+    if (!game.Init())
+        return 1;
+
     game.Play();
 
     return 0;
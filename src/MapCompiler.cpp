@@ -0,0 +1,44 @@
+#include "MapLoader.h"
+
+#include <iostream>
+
+// size of the maps without the header, same as in the game
+static const int32_t DEFAULT_ROWS = 10;
+static const int32_t DEFAULT_COLUMNS = 8;
+
+int main(int argc, char* argv[])
+{
+    bool validate = true;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--no-validate") validate = false;
+        else paths.push_back(arg);
+    }
+
+    if (paths.empty())
+    {
+        std::cout << "Usage: " << argv[0] << " [--no-validate] <maps...>" << std::endl;
+        return 1;
+    }
+
+    for (const std::string& path : paths)
+    {
+        try
+        {
+            MapLoader loader(path, DEFAULT_ROWS, DEFAULT_COLUMNS);
+            loader.Compile(MapLoader::GetCompiledPath(path), validate);
+        }
+        catch (const MapLoaderException& e)
+        {
+            std::cout << path << ": " << e.Message() << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Compiled " << paths.size() << " maps." << std::endl;
+    return 0;
+}
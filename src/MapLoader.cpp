@@ -1,43 +1,216 @@
 #include "MapLoader.h"
+#include "Utility.h"
 
 #include <string>
+#include <algorithm>
+#include <cstring>
 
-Map::Map(const std::vector<std::vector<int32_t>>& layout)
-    : Layout(layout) { }
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// optional first line of the map file - size <rows> <columns>
+static const std::string MAP_HEADER = "size";
+
+// compiled map layout - header followed by the row-major cells
+static const char MAPB_MAGIC[4] = { 'R', 'V', 'M', 'B' };
+static const uint32_t MAPB_VERSION = 1;
+static const uint32_t MAPB_VALIDATED = 1;
+static const std::string MAPB_EXTENSION = ".mapb";
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ull;
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+struct MapbHeader
+{
+    char Magic[4];
+    uint32_t Version;
+    int32_t Rows;
+    int32_t Columns;
+    uint32_t Flags;
+    uint32_t Reserved;
+    uint64_t SourceHash; // hash of the text the map was compiled from
+};
+
+Map::Map(int32_t rows, int32_t columns)
+    : _rows(rows), _columns(columns), _cells((size_t)rows * columns, 0) { }
+
+int32_t Map::GetRows() const
+{
+    return _rows;
+}
+
+int32_t Map::GetColumns() const
+{
+    return _columns;
+}
 
 MapLoader::MapLoader(const std::string& fileName, int32_t rows, int32_t columns)
-    : _rows(rows), _columns(columns), _mapPath(fileName), _ifstream(fileName, std::ios::in) { }
+    : _rows(rows), _columns(columns), _mapPath(fileName) { }
 
 Map MapLoader::Load()
 {
-    if (_rows < 1 || _columns < 1)
+    return Load(true);
+}
+
+Map MapLoader::Load(bool cache)
+{
+    MappedFile file(_mapPath);
+
+    if (!file.IsOpen())
+        throw MapLoaderException("Failed to open the map file!");
+
+    Map map(0, 0);
+    uint64_t hash;
+    bool validated;
+
+    // compiled map given directly
+    if (file.GetSize() >= sizeof(MAPB_MAGIC) && std::equal(MAPB_MAGIC, MAPB_MAGIC + sizeof(MAPB_MAGIC), (const char*)file.GetData()))
+    {
+        if (!ReadCompiled(file.GetData(), file.GetSize(), map, hash, validated))
+            throw MapLoaderException("Invalid compiled map!");
+
+        if (!validated)
+            Validate(map);
+
+        return map;
+    }
+
+    if (!cache)
+    {
+        map = Parse(file.GetData(), file.GetSize());
+        Validate(map);
+        return map;
+    }
+
+    hash = Hash(file.GetData(), file.GetSize());
+    std::string compiledPath = GetCompiledPath(_mapPath);
+
+    {
+        uint64_t compiledHash;
+        MappedFile compiled(compiledPath);
+
+        if (compiled.IsOpen() && ReadCompiled(compiled.GetData(), compiled.GetSize(), map, compiledHash, validated) && compiledHash == hash)
+        {
+            if (!validated)
+                Validate(map);
+
+            return map;
+        }
+    }
+
+    map = Parse(file.GetData(), file.GetSize());
+    Validate(map);
+
+    // the compiled map is only a cache, maps in read-only directories keep using the text
+    try { WriteCompiled(map, compiledPath, hash, true); }
+    catch (const MapLoaderException&) { }
+
+    return map;
+}
+
+void MapLoader::Compile(const std::string& output, bool validate)
+{
+    MappedFile file(_mapPath);
+
+    if (!file.IsOpen())
+        throw MapLoaderException("Failed to open the map file!");
+
+    Map map = Parse(file.GetData(), file.GetSize());
+
+    if (validate)
+        Validate(map);
+
+    WriteCompiled(map, output, Hash(file.GetData(), file.GetSize()), validate);
+}
+
+std::string MapLoader::GetCompiledPath(const std::string& mapPath)
+{
+    size_t name = mapPath.find_last_of('/');
+    size_t extension = mapPath.find_last_of('.');
+
+    if (extension == std::string::npos || (name != std::string::npos && extension < name))
+        return mapPath + MAPB_EXTENSION;
+
+    return mapPath.substr(0, extension) + MAPB_EXTENSION;
+}
+
+Map MapLoader::Parse(const uint8_t* data, size_t size) const
+{
+    const char* cursor = (const char*)data;
+    const char* end = cursor + size;
+    const char* first;
+    const char* last;
+    int32_t line = 0;
+    int32_t column = 0;
+
+    if (!NextLine(cursor, end, line, column, first, last))
+        throw Error("Invalid number of rows", line + 1, 1);
+
+    int32_t rows = _rows;
+    int32_t columns = _columns;
+    bool header = (size_t)(last - first) >= MAP_HEADER.size() && std::equal(MAP_HEADER.begin(), MAP_HEADER.end(), first)
+        && (first + MAP_HEADER.size() == last || IsBlank(first[MAP_HEADER.size()]));
+
+    if (header)
+    {
+        const char* number = first + MAP_HEADER.size();
+
+        if (!ParseNumber(number, last, rows) || !ParseNumber(number, last, columns) || number != last)
+            throw Error("Invalid map header", line, column + (int32_t)(number - first));
+    }
+
+    if (rows < 1 || columns < 1)
         throw MapLoaderException("Can't load a map with zero rows/columns parameters");
 
-    if (_ifstream.fail())
-        throw MapLoaderException("Failed to create input file stream!");
+    if (rows > MAX_DIMENSION || columns > MAX_DIMENSION || (int64_t)rows * columns > MAX_CELLS)
+        throw MapLoaderException("The map is too large!");
 
-    std::vector<std::vector<int32_t>> layout(_rows, std::vector<int32_t>(_columns, 0));
+    Map map(rows, columns);
 
-    std::string temp;
-    for (int32_t i = 0; i < _rows; ++i)
+    for (int32_t i = 0; i < rows; ++i)
     {
-        if (!(_ifstream >> temp))
-            throw MapLoaderException("Invalid number of rows!");
+        // the first line is already the first row unless it is the header
+        if ((i > 0 || header) && !NextLine(cursor, end, line, column, first, last))
+            throw Error("Invalid number of rows", line + 1, 1);
 
-        if ((int32_t)temp.length() != _columns)
-            throw MapLoaderException("Invalid number of columns inside of a row!");
+        if (last - first != columns)
+            throw Error("Invalid number of columns inside of a row", line, column + std::min((int32_t)(last - first), columns));
 
-        for (size_t j = 0; j < temp.length(); ++j)
-            layout[i][j] = ParseFromChar(temp[j]);
+        size_t invalid = ParseRow(first, (size_t)columns, map.GetRow(i));
+        if (invalid < (size_t)columns)
+            throw Error("Invalid character", line, column + (int32_t)invalid);
     }
 
-    if (!_ifstream.eof())
-        throw MapLoaderException("Invalid number of rows!");
+    if (NextLine(cursor, end, line, column, first, last))
+        throw Error("Invalid number of rows", line, column);
+
+    return map;
+}
+
+void MapLoader::Validate(const Map& map)
+{
+    if (!IsValid(map))
+    {
+        std::vector<MapCell> unreachable = FindUnreachable(map);
+        std::string message = "The map is unfinishable!";
 
-    if (!IsValid(layout))
-        throw MapLoaderException("The map is unfinishable!");
+        if (!unreachable.empty())
+        {
+            message += " Unreachable bricks (row, column):";
+            for (size_t i = 0; i < unreachable.size() && i < MAX_REPORTED_CELLS; ++i)
+                message += " (" + std::to_string(unreachable[i].Row + 1) + ", " + std::to_string(unreachable[i].Column + 1) + ")";
+            if (unreachable.size() > MAX_REPORTED_CELLS)
+                message += " and " + std::to_string(unreachable.size() - MAX_REPORTED_CELLS) + " more";
+        }
 
-    return Map(layout);
+        throw MapLoaderException(message);
+    }
 }
 
 std::string MapLoader::GetMapPath() const
@@ -45,14 +218,236 @@ std::string MapLoader::GetMapPath() const
     return _mapPath;
 }
 
-int32_t MapLoader::ParseFromChar(char ch)
+bool MapLoader::IsBlank(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\v' || ch == '\f';
+}
+
+bool MapLoader::NextLine(const char*& cursor, const char* end, int32_t& line, int32_t& column, const char*& first, const char*& last)
+{
+    // empty lines are skipped, the others are trimmed of the surrounding blanks including the carriage return
+    while (cursor < end)
+    {
+        const char* lineEnd = (const char*)std::memchr(cursor, '\n', (size_t)(end - cursor));
+        if (lineEnd == nullptr)
+            lineEnd = end;
+
+        first = cursor;
+        last = lineEnd;
+        cursor = lineEnd < end ? lineEnd + 1 : end;
+        ++line;
+
+        const char* start = first;
+        while (first < last && IsBlank(*first)) ++first;
+        while (last > first && IsBlank(last[-1])) --last;
+
+        if (first < last)
+        {
+            column = (int32_t)(first - start) + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MapLoader::ParseNumber(const char*& cursor, const char* end, int32_t& value)
+{
+    while (cursor < end && IsBlank(*cursor)) ++cursor;
+
+    int64_t number = 0;
+    const char* start = cursor;
+
+    // values over the limit are only kept above it, the size check rejects them
+    for (; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor)
+        number = std::min<int64_t>(number * 10 + (*cursor - '0'), (int64_t)MAX_DIMENSION + 1);
+
+    value = (int32_t)number;
+    return cursor > start && (cursor == end || IsBlank(*cursor));
+}
+
+size_t MapLoader::ParseRow(const char* text, size_t count, int8_t* cells)
 {
-    if (isdigit(ch)) return ch - '0';
-    if (ch == CHAR_WALL) return -1;
-    throw MapLoaderException("Invalid character!");
+    size_t i = 0;
+
+#ifdef __SSE2__
+    // sixteen characters at a time, digits become their values and walls become -1
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i belowZero = _mm_set1_epi8('0' - 1);
+    const __m128i aboveNine = _mm_set1_epi8('9' + 1);
+    const __m128i wall = _mm_set1_epi8(CHAR_WALL);
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i digits = _mm_and_si128(_mm_cmpgt_epi8(chunk, belowZero), _mm_cmplt_epi8(chunk, aboveNine));
+        __m128i walls = _mm_cmpeq_epi8(chunk, wall);
+
+        int32_t valid = _mm_movemask_epi8(_mm_or_si128(digits, walls));
+        if (valid != 0xFFFF)
+            return i + __builtin_ctz(~valid);
+
+        _mm_storeu_si128((__m128i*)(cells + i), _mm_or_si128(_mm_and_si128(_mm_sub_epi8(chunk, zero), digits), walls));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        if (text[i] >= '0' && text[i] <= '9') cells[i] = (int8_t)(text[i] - '0');
+        else if (text[i] == CHAR_WALL) cells[i] = -1;
+        else return i;
+    }
+
+    return count;
+}
+
+uint64_t MapLoader::Hash(const uint8_t* data, size_t size) const
+{
+    // FNV-1a over 8 byte words, the dimensions of maps without the header are part of the source
+    uint64_t hash = FNV_OFFSET;
+    uint64_t word;
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+
+    for (; i < size; ++i)
+        hash = (hash ^ data[i]) * FNV_PRIME;
+
+    hash = (hash ^ (uint32_t)_rows) * FNV_PRIME;
+    hash = (hash ^ (uint32_t)_columns) * FNV_PRIME;
+    return hash;
+}
+
+bool MapLoader::ReadCompiled(const uint8_t* data, size_t size, Map& map, uint64_t& hash, bool& validated)
+{
+    MapbHeader header;
+
+    if (size < sizeof(header))
+        return false;
+
+    std::memcpy(&header, data, sizeof(header));
+
+    if (!std::equal(MAPB_MAGIC, MAPB_MAGIC + sizeof(MAPB_MAGIC), header.Magic) || header.Version != MAPB_VERSION)
+        return false;
+
+    if (header.Rows < 1 || header.Columns < 1 || header.Rows > MAX_DIMENSION || header.Columns > MAX_DIMENSION
+        || (int64_t)header.Rows * header.Columns > MAX_CELLS || size != sizeof(header) + (size_t)header.Rows * header.Columns)
+        return false;
+
+    const uint8_t* cells = data + sizeof(header);
+    size_t count = (size_t)header.Rows * header.Columns;
+
+    // values outside of the text format would index past the brick textures
+    if (!IsInRange(cells, count))
+        return false;
+
+    map = Map(header.Rows, header.Columns);
+    std::memcpy(map.GetRow(0), cells, count);
+    hash = header.SourceHash;
+    validated = header.Flags & MAPB_VALIDATED;
+    return true;
+}
+
+bool MapLoader::IsInRange(const uint8_t* cells, size_t count)
+{
+    static const uint64_t HIGH_BITS = 0x8080808080808080ull;
+    static const uint64_t LOW_BITS = 0x7f7f7f7f7f7f7f7full;
+    static const uint64_t ONES = 0x0101010101010101ull;
+    static const uint64_t ELEVENS = 0x0b0b0b0b0b0b0b0bull;
+
+    uint64_t invalid = 0;
+    size_t i = 0;
+
+    // eight cells at a time, cells shifted by one have to be below eleven
+    for (; i + 8 <= count; i += 8)
+    {
+        uint64_t chunk;
+        std::memcpy(&chunk, cells + i, sizeof(chunk));
+
+        uint64_t shifted = ((chunk & LOW_BITS) + ONES) ^ (chunk & HIGH_BITS);
+        invalid |= (((shifted | HIGH_BITS) - ELEVENS) | shifted) & HIGH_BITS;
+    }
+
+    for (; i < count; ++i)
+        invalid |= (int8_t)cells[i] < -1 || (int8_t)cells[i] > 9;
+
+    return invalid == 0;
+}
+
+void MapLoader::WriteCompiled(const Map& map, const std::string& path, uint64_t hash, bool validated)
+{
+    MapbHeader header = {};
+    std::memcpy(header.Magic, MAPB_MAGIC, sizeof(MAPB_MAGIC));
+    header.Version = MAPB_VERSION;
+    header.Rows = map.GetRows();
+    header.Columns = map.GetColumns();
+    header.Flags = validated ? MAPB_VALIDATED : 0;
+    header.SourceHash = hash;
+
+    // written next to the target and renamed over it, readers see the old or the new file
+    std::vector<char> temporary(path.begin(), path.end());
+    const char suffix[] = ".XXXXXX";
+    temporary.insert(temporary.end(), suffix, suffix + sizeof(suffix));
+
+    int fd = mkstemp(temporary.data());
+    if (fd < 0)
+        throw MapLoaderException("Failed to create compiled map " + path + "!");
+
+    // the temporary file is private, the compiled map is readable like the text map
+    fchmod(fd, 0644);
+
+    bool written = WriteAll(fd, (const uint8_t*)&header, sizeof(header))
+        && WriteAll(fd, (const uint8_t*)map.GetRow(0), (size_t)map.GetRows() * map.GetColumns());
+
+    if (close(fd) != 0 || !written || rename(temporary.data(), path.c_str()) != 0)
+    {
+        unlink(temporary.data());
+        throw MapLoaderException("Failed to write compiled map " + path + "!");
+    }
 }
 
-bool MapLoader::IsValid(const std::vector<std::vector<int32_t>>& layout)
+bool MapLoader::WriteAll(int fd, const uint8_t* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t count = write(fd, data, size);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+
+        data += count;
+        size -= (size_t)count;
+    }
+
+    return true;
+}
+
+MapLoaderException MapLoader::Error(const std::string& message, int32_t line, int32_t column)
+{
+    return MapLoaderException(message + " at line " + std::to_string(line) + ", column " + std::to_string(column) + "!");
+}
+
+bool MapLoader::IsValid(const Map& map)
+{
+    // zero breakable bricks
+    bool bricks = false;
+    for (int32_t i = 0; i < map.GetRows() && !bricks; ++i)
+    {
+        const int8_t* row = map.GetRow(i);
+        for (int32_t j = 0; j < map.GetColumns() && !bricks; ++j)
+            bricks = row[j] > 0;
+    }
+
+    return bricks && FindUnreachable(map).empty();
+}
+
+std::vector<MapCell> MapLoader::FindUnreachable(const Map& map)
 {
     // TODO: in case of any changes to the game configuration - check if this is still valid
     /*
@@ -60,51 +455,141 @@ bool MapLoader::IsValid(const std::vector<std::vector<int32_t>>& layout)
     diameter is 12 units and the smallest offset between walls and bricks is 18 units we don't have to.
     */
 
-    uint32_t count = 0;
-    std::vector<std::vector<int32_t>> grid(layout.size() + 2, std::vector<int32_t>(layout[0].size() + 2, 0));
+    // one bit per cell, the cells outside of the map are where the ball comes from so the open border cells are reached
+    size_t rows = map.GetRows();
+    size_t columns = map.GetColumns();
+    size_t words = (columns + 63) / 64;
+    uint64_t last = 1ull << ((columns - 1) % 64);
+
+    std::vector<uint64_t> open(rows * words);
+    std::vector<uint64_t> bricks(rows * words);
+    std::vector<uint64_t> reach(rows * words);
 
-    for (size_t i = 0; i < layout.size(); ++i) for (size_t j = 0; j < layout[0].size(); ++j)
+    for (size_t i = 0; i < rows; ++i)
     {
-        grid[1 + i][1 + j] = layout[i][j];
-        if (layout[i][j] > 0) ++count;
+        const int8_t* cells = map.GetRow((int32_t)i);
+
+        for (size_t w = 0; w < words; ++w)
+        {
+            uint64_t openWord;
+            uint64_t brickWord;
+            PackCells(cells + w * 64, std::min<size_t>(64, columns - w * 64), openWord, brickWord);
+
+            open[i * words + w] = openWord;
+            bricks[i * words + w] = brickWord;
+            reach[i * words + w] = (i == 0 || i == rows - 1) ? openWord : 0;
+        }
+
+        reach[i * words] |= open[i * words] & 1;
+        reach[i * words + words - 1] |= open[i * words + words - 1] & last;
     }
 
-    // zero breakable bricks
-    if (count == 0)
-        return false;
+    // alternate downward and upward sweeps until nothing new is reached
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
 
-    std::pair<size_t, size_t> temp;
-    std::vector<std::pair<size_t, size_t>> stack;
-    stack.push_back({ 0, 0 });
+        for (size_t i = 1; i < rows; ++i)
+            changed |= SpreadRow(&reach[i * words], &reach[(i - 1) * words], &open[i * words], words);
 
-    while (!stack.empty())
+        for (size_t i = rows - 1; i-- > 0;)
+            changed |= SpreadRow(&reach[i * words], &reach[(i + 1) * words], &open[i * words], words);
+    }
+
+    std::vector<MapCell> unreachable;
+    for (size_t i = 0; i < rows; ++i) for (size_t w = 0; w < words; ++w)
     {
-        temp = stack.back();
-        stack.pop_back();
+        uint64_t left = bricks[i * words + w] & ~reach[i * words + w];
 
-        // if visited or wall
-        if (grid[temp.first][temp.second] < 0)
-            continue;
+        while (left)
+        {
+            unreachable.push_back({ (int32_t)i, (int32_t)(w * 64) + __builtin_ctzll(left) });
+            left &= left - 1;
+        }
+    }
+
+    return unreachable;
+}
+
+void MapLoader::PackCells(const int8_t* cells, size_t count, uint64_t& open, uint64_t& bricks)
+{
+    static const uint64_t HIGH_BITS = 0x8080808080808080ull;
+    static const uint64_t LOW_BITS = 0x7f7f7f7f7f7f7f7full;
+    static const uint64_t GATHER = 0x0102040810204080ull;
+
+    open = 0;
+    bricks = 0;
+    size_t k = 0;
 
-        // mark as visited
-        grid[temp.first][temp.second] = -2;
+    // eight cells at a time, the high bit of each byte is moved to the top byte by the multiplication (little endian)
+    for (; k + 8 <= count; k += 8)
+    {
+        uint64_t chunk;
+        std::memcpy(&chunk, cells + k, sizeof(chunk));
+
+        uint64_t walls = chunk & HIGH_BITS;
+        uint64_t nonzero = (((chunk & LOW_BITS) + LOW_BITS) | chunk) & HIGH_BITS;
 
-        if (temp.second < grid[0].size() - 1)
-            stack.push_back({ temp.first, temp.second + 1 });
-        if (temp.first < grid.size() - 1)
-            stack.push_back({ temp.first + 1, temp.second });
-        if (temp.second > 0)
-            stack.push_back({ temp.first, temp.second - 1 });
-        if (temp.first > 0)
-            stack.push_back({ temp.first - 1, temp.second });
+        open |= ((((walls ^ HIGH_BITS) >> 7) * GATHER) >> 56) << k;
+        bricks |= ((((nonzero & ~walls) >> 7) * GATHER) >> 56) << k;
     }
 
-    // check for unreachable connected components
-    for (size_t i = 0; i < grid.size(); i++) for (size_t j = 0; j < grid[0].size(); j++)
+    for (; k < count; ++k)
     {
-        if (grid[i][j] > 0)
-            return false;
+        open |= (uint64_t)(cells[k] >= 0) << k;
+        bricks |= (uint64_t)(cells[k] > 0) << k;
     }
+}
 
-    return true;
+uint64_t MapLoader::FillUp(uint64_t reach, uint64_t open)
+{
+    // Kogge-Stone occluded fill, open keeps the bits with 2^n open cells below them
+    reach &= open;
+    reach |= open & (reach << 1); open &= open << 1;
+    reach |= open & (reach << 2); open &= open << 2;
+    reach |= open & (reach << 4); open &= open << 4;
+    reach |= open & (reach << 8); open &= open << 8;
+    reach |= open & (reach << 16); open &= open << 16;
+    reach |= open & (reach << 32);
+    return reach;
+}
+
+uint64_t MapLoader::FillDown(uint64_t reach, uint64_t open)
+{
+    reach &= open;
+    reach |= open & (reach >> 1); open &= open >> 1;
+    reach |= open & (reach >> 2); open &= open >> 2;
+    reach |= open & (reach >> 4); open &= open >> 4;
+    reach |= open & (reach >> 8); open &= open >> 8;
+    reach |= open & (reach >> 16); open &= open >> 16;
+    reach |= open & (reach >> 32);
+    return reach;
+}
+
+bool MapLoader::SpreadRow(uint64_t* row, const uint64_t* neighbour, const uint64_t* open, size_t words)
+{
+    uint64_t added = 0;
+    uint64_t carry = 0;
+
+    // towards the higher columns, the last column of a word continues into the next word
+    for (size_t w = 0; w < words; ++w)
+    {
+        uint64_t filled = FillUp(row[w] | neighbour[w] | carry, open[w]);
+        added |= filled & ~row[w];
+        row[w] = filled;
+        carry = filled >> 63;
+    }
+
+    // towards the lower columns
+    carry = 0;
+    for (size_t w = words; w-- > 0;)
+    {
+        uint64_t filled = FillDown(row[w] | carry, open[w]);
+        added |= filled & ~row[w];
+        row[w] = filled;
+        carry = filled << 63;
+    }
+
+    return added != 0;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
-#include <fstream>
+#include <cstdint>
+#include <string>
 #include <vector>
 
 /**
@@ -30,18 +31,68 @@ public:
 };
 
 /**
- * @brief Class used for storing map layout.
+ * @brief Class used for storing map layout. Cells are stored in a flat row-major grid, -1 is a wall, 0 is empty and positive values are bricks.
 */
 class Map
 {
+private:
+    int32_t _rows;
+    int32_t _columns;
+    std::vector<int8_t> _cells;
+
 public:
-    std::vector<std::vector<int32_t>> Layout;
+    /**
+     * @brief Create a new instance of the object with empty cells.
+     * @param rows Number of rows.
+     * @param columns Number of columns.
+    */
+    Map(int32_t rows, int32_t columns);
 
     /**
-     * @brief Create a new instance of the object.
-     * @param layout Data in form of 2D array.
+     * @brief Cell getter.
+     * @param row Row of the cell.
+     * @param column Column of the cell.
+     * @return Value of the cell.
+    */
+    inline int8_t Get(int32_t row, int32_t column) const { return _cells[(size_t)row * _columns + column]; }
+    /**
+     * @brief Cell setter.
+     * @param row Row of the cell.
+     * @param column Column of the cell.
+     * @param value Value of the cell.
+    */
+    inline void Set(int32_t row, int32_t column, int8_t value) { _cells[(size_t)row * _columns + column] = value; }
+    /**
+     * @brief Row getter.
+     * @param row Index of the row.
+     * @return Pointer to the cells of the row.
+    */
+    inline const int8_t* GetRow(int32_t row) const { return &_cells[(size_t)row * _columns]; }
+    /**
+     * @brief Row getter.
+     * @param row Index of the row.
+     * @return Pointer to the cells of the row.
+    */
+    inline int8_t* GetRow(int32_t row) { return &_cells[(size_t)row * _columns]; }
+    /**
+     * @brief Number of rows getter.
+     * @return Value of the number of rows.
+    */
+    int32_t GetRows() const;
+    /**
+     * @brief Number of columns getter.
+     * @return Value of the number of columns.
     */
-    Map(const std::vector<std::vector<int32_t>>& layout);
+    int32_t GetColumns() const;
+};
+
+/**
+ * @brief Structure used for storing position of a map cell.
+*/
+struct MapCell
+{
+    int32_t Row;
+    int32_t Column;
 };
 
 /**
@@ -51,42 +102,186 @@ class MapLoader
 {
 private:
     static const char CHAR_WALL = '#';
+    static const int32_t MAX_DIMENSION = 65536;
+    static const int64_t MAX_CELLS = 1 << 28;
+    static const size_t MAX_REPORTED_CELLS = 10;
 
     int32_t _rows;
     int32_t _columns;
     std::string _mapPath;
-    std::ifstream _ifstream;
 
 public:
     /**
-     * @brief Create a new instance of the object.
+     * @brief Create a new instance of the object. Maps starting with a "size <rows> <columns>" header line define their own dimensions.
      * @param fileName Map file path.
-     * @param rows Number of rows.
-     * @param columns Number of columns.
+     * @param rows Number of rows of maps without the header.
+     * @param columns Number of columns of maps without the header.
     */
     MapLoader(const std::string& fileName, int32_t rows, int32_t columns);
     /**
-     * @brief Load the data.
+     * @brief Load the data. Uses the compiled map when it was compiled from the current text, otherwise parses the text and refreshes the compiled map.
      * @return Map object with the loaded data.
     */
     Map Load();
+    /**
+     * @brief Load the data.
+     * @param cache Use and refresh the compiled map, otherwise the text is always parsed and nothing is written.
+     * @return Map object with the loaded data.
+    */
+    Map Load(bool cache);
+    /**
+     * @brief Compile the map to the binary format.
+     * @param output Compiled map file path.
+     * @param validate Validate the map before compiling, unvalidated maps are validated on every load.
+    */
+    void Compile(const std::string& output, bool validate);
     /**
      * @brief Map file path getter.
      * @return Value of the map file path.
     */
     std::string GetMapPath() const;
+    /**
+     * @brief Compiled map file path getter.
+     * @param mapPath Map file path.
+     * @return Map file path with the .mapb extension.
+    */
+    static std::string GetCompiledPath(const std::string& mapPath);
+    /**
+     * @brief Validates the map. The map needs at least one destroyable brick and all of them reachable.
+     * @param map Map to validate.
+     * @return True if data are valid map.
+    */
+    static bool IsValid(const Map& map);
+    /**
+     * @brief Find the bricks that can't be reached from outside of the map. Reachability is propagated on packed row bitsets a word at a time.
+     * @param map Map to check.
+     * @return Positions of the unreachable bricks in row-major order.
+    */
+    static std::vector<MapCell> FindUnreachable(const Map& map);
 
 private:
     /**
-     * @brief Parse character from the data.
-     * @param ch Character to be parsed.
-     * @return Numerical value.
+     * @brief Parse the text format.
+     * @param data Content of the map file.
+     * @param size Size of the content.
+     * @return Map object with the parsed data.
     */
-    static int32_t ParseFromChar(char ch);
+    Map Parse(const uint8_t* data, size_t size) const;
     /**
-     * @brief Validates the map. Uses DFS.
-     * @param layout Data in form of 2D array.
-     * @return True if data are valid map.
+     * @brief Throw if the map isn't valid, the unreachable bricks are listed in the exception.
+     * @param map Map to validate.
+    */
+    static void Validate(const Map& map);
+    /**
+     * @brief Hash the map source.
+     * @param data Content of the map file.
+     * @param size Size of the content.
+     * @return Hash of the content and the dimensions used for maps without the header.
+    */
+    uint64_t Hash(const uint8_t* data, size_t size) const;
+    /**
+     * @brief Read a compiled map.
+     * @param data Content of the compiled map file.
+     * @param size Size of the content.
+     * @param map Output map.
+     * @param hash Output hash of the source.
+     * @param validated Output flag of a validated map.
+     * @return True if the content is a well formed compiled map.
+    */
+    static bool ReadCompiled(const uint8_t* data, size_t size, Map& map, uint64_t& hash, bool& validated);
+    /**
+     * @brief Check the compiled cells for values of the text format, -1 to 9.
+     * @param cells Cells to check.
+     * @param count Number of cells.
+     * @return True if all cells are in the range.
+    */
+    static bool IsInRange(const uint8_t* cells, size_t count);
+    /**
+     * @brief Atomically replace the compiled map file.
+     * @param map Map to write.
+     * @param path Compiled map file path.
+     * @param hash Hash of the source.
+     * @param validated Flag of a validated map.
+    */
+    static void WriteCompiled(const Map& map, const std::string& path, uint64_t hash, bool validated);
+    /**
+     * @brief Write the whole buffer to the descriptor.
+     * @param fd File descriptor.
+     * @param data Data to write.
+     * @param size Size of the data.
+     * @return True if everything was written.
+    */
+    static bool WriteAll(int fd, const uint8_t* data, size_t size);
+    /**
+     * @brief Check for a blank character inside of a line.
+     * @param ch Character to check.
+     * @return True if the character is blank.
+    */
+    static bool IsBlank(char ch);
+    /**
+     * @brief Find the next non-empty line of the data.
+     * @param cursor Position in the data, moved past the line.
+     * @param end End of the data.
+     * @param line Number of the current line, updated to the found line.
+     * @param column Output column of the first non-blank character.
+     * @param first Output first non-blank character of the line.
+     * @param last Output end of the line without the trailing blanks.
+     * @return True if a line was found.
+    */
+    static bool NextLine(const char*& cursor, const char* end, int32_t& line, int32_t& column, const char*& first, const char*& last);
+    /**
+     * @brief Parse a blank separated number.
+     * @param cursor Position in the line, moved past the number.
+     * @param end End of the line.
+     * @param value Output value.
+     * @return True if a number was parsed.
+    */
+    static bool ParseNumber(const char*& cursor, const char* end, int32_t& value);
+    /**
+     * @brief Convert the characters of a row to the cells. Uses SSE2 when available.
+     * @param text Characters of the row.
+     * @param count Number of characters.
+     * @param cells Output cells.
+     * @return Index of the first invalid character, count if all are valid.
+    */
+    static size_t ParseRow(const char* text, size_t count, int8_t* cells);
+    /**
+     * @brief Create an exception pointing to a position in the map file.
+     * @param message Error description.
+     * @param line Line of the error.
+     * @param column Column of the error.
+     * @return Exception with the position.
+    */
+    static MapLoaderException Error(const std::string& message, int32_t line, int32_t column);
+    /**
+     * @brief Pack up to 64 cells to bit masks, bit k belongs to the cell k.
+     * @param cells Cells to pack.
+     * @param count Number of cells.
+     * @param open Output mask of the cells that aren't walls.
+     * @param bricks Output mask of the destroyable bricks.
+    */
+    static void PackCells(const int8_t* cells, size_t count, uint64_t& open, uint64_t& bricks);
+    /**
+     * @brief Spread reachability towards the higher bits through the open bits of a word.
+     * @param reach Reached bits.
+     * @param open Open bits.
+     * @return Reached bits after the spread.
+    */
+    static uint64_t FillUp(uint64_t reach, uint64_t open);
+    /**
+     * @brief Spread reachability towards the lower bits through the open bits of a word.
+     * @param reach Reached bits.
+     * @param open Open bits.
+     * @return Reached bits after the spread.
+    */
+    static uint64_t FillDown(uint64_t reach, uint64_t open);
+    /**
+     * @brief Take over the reachability of the neighbouring row and spread it along the row.
+     * @param row Reached bits of the row.
+     * @param neighbour Reached bits of the neighbouring row.
+     * @param open Open bits of the row.
+     * @param words Number of words per row.
+     * @return True if any new bit was reached.
     */
-    static bool IsValid(const std::vector<std::vector<int32_t>>& layout);
+    static bool SpreadRow(uint64_t* row, const uint64_t* neighbour, const uint64_t* open, size_t words);
 };
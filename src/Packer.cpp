@@ -0,0 +1,27 @@
+#include "TextureLoader.h"
+
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: " << argv[0] << " <output pack> <textures...>" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> paths(argv + 2, argv + argc);
+
+    try
+    {
+        TextureLoader::Bake(paths, argv[1]);
+    }
+    catch (const TextureLoaderException& e)
+    {
+        std::cout << e.Message() << std::endl;
+        return 1;
+    }
+
+    std::cout << "Packed " << paths.size() << " textures into " << argv[1] << "." << std::endl;
+    return 0;
+}
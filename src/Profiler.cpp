@@ -0,0 +1,181 @@
+#include "Profiler.h"
+
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+
+static const char* SECTION_NAMES[] = { "Frame", "ProcessEvents", "Update", "CollisionBonuses", "CollisionBall", "Draw", "Present" };
+
+Profiler::Profiler(bool enabled)
+    : _enabled(enabled), _frame(0), _origin(SDL_GetPerformanceCounter()), _frequency((double)SDL_GetPerformanceFrequency()), _next(0), _count(0), _overlay()
+{
+    if (_enabled)
+        _samples.resize(CAPACITY);
+}
+
+bool Profiler::IsEnabled() const
+{
+    return _enabled;
+}
+
+void Profiler::BeginFrame()
+{
+    ++_frame;
+
+    // a single pass over the ring for all the overlay lines, not on every drawn frame
+    if (!_enabled || _frame % OVERLAY_INTERVAL != 0)
+        return;
+
+    std::vector<double> durations = Durations(FRAME);
+    _overlay[0] = Rank(durations, 50);
+    _overlay[1] = Rank(durations, 95);
+    _overlay[2] = Rank(durations, 99);
+}
+
+void Profiler::Record(Section section, uint64_t begin, uint64_t end)
+{
+    _samples[_next] = { _frame, begin, end, section };
+    _next = (_next + 1) % CAPACITY;
+    _count = _count < CAPACITY ? _count + 1 : CAPACITY;
+}
+
+double Profiler::Percentile(Section section, double percentile) const
+{
+    std::vector<double> durations = Durations(section);
+    return Rank(durations, percentile);
+}
+
+void Profiler::Draw(const RenderManager& renderer, int32_t x, int32_t y, double budget) const
+{
+    if (!_enabled || renderer.IsHeadless())
+        return;
+
+    renderer.FillRect({ x, y, GRAPH_FRAMES, GRAPH_HEIGHT }, { 0, 0, 0, 160 });
+
+    // newest frame on the right, walk the ring backwards
+    int32_t column = GRAPH_FRAMES;
+
+    for (size_t i = 0; i < _count && column > 0; ++i)
+    {
+        const Sample& sample = _samples[(_next + CAPACITY - 1 - i) % CAPACITY];
+
+        if (sample.Id != FRAME)
+            continue;
+
+        double ms = Microseconds(sample.End - sample.Begin) / 1000.0;
+        int32_t height = GraphHeight(ms);
+        Color color = ms <= budget ? Color{ 0, 200, 0, 255 } : ms <= 2 * budget ? Color{ 230, 200, 0, 255 } : Color{ 230, 0, 0, 255 };
+
+        renderer.FillRect({ x + --column, y + GRAPH_HEIGHT - height, 1, height }, color);
+    }
+
+    // budget and percentile lines
+    const std::pair<double, Color> lines[] =
+    {
+        { budget, { 255, 255, 255, 255 } },
+        { _overlay[0], { 0, 255, 0, 255 } },
+        { _overlay[1], { 255, 255, 0, 255 } },
+        { _overlay[2], { 255, 0, 0, 255 } }
+    };
+
+    for (const auto& line : lines)
+    {
+        int32_t height = GraphHeight(line.first);
+        renderer.FillRect({ x, y + GRAPH_HEIGHT - height, GRAPH_FRAMES, 1 }, line.second);
+    }
+}
+
+void Profiler::PrintSummary(std::ostream& os) const
+{
+    os << "section\tp50 ms\tp95 ms\tp99 ms\tmax ms" << std::endl;
+
+    for (int32_t i = 0; i < SECTION_COUNT; ++i)
+        os << SECTION_NAMES[i] << "\t" << Percentile((Section)i, 50) << "\t" << Percentile((Section)i, 95) << "\t" << Percentile((Section)i, 99) << "\t" << Percentile((Section)i, 100) << std::endl;
+}
+
+void Profiler::ExportCsv(const std::string& path) const
+{
+    std::ofstream ofs(path, std::ios::out | std::ios::trunc);
+
+    if (ofs.fail())
+        throw ProfilerException("Failed to initialize output file stream!");
+
+    ofs << "frame,section,begin_us,duration_us" << std::endl;
+
+    for (const Sample& sample : Ordered())
+        ofs << sample.Frame << "," << SECTION_NAMES[sample.Id] << "," << Microseconds(sample.Begin - _origin) << "," << Microseconds(sample.End - sample.Begin) << std::endl;
+
+    if (!ofs)
+        throw ProfilerException("Failed to export the profile!");
+}
+
+void Profiler::ExportTrace(const std::string& path) const
+{
+    std::ofstream ofs(path, std::ios::out | std::ios::trunc);
+
+    if (ofs.fail())
+        throw ProfilerException("Failed to initialize output file stream!");
+
+    ofs << "{\"traceEvents\":[";
+
+    bool first = true;
+    for (const Sample& sample : Ordered())
+    {
+        ofs << (first ? "" : ",") << std::endl
+            << "{\"name\":\"" << SECTION_NAMES[sample.Id] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << Microseconds(sample.Begin - _origin)
+            << ",\"dur\":" << Microseconds(sample.End - sample.Begin) << ",\"args\":{\"frame\":" << sample.Frame << "}}";
+        first = false;
+    }
+
+    ofs << std::endl << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+
+    if (!ofs)
+        throw ProfilerException("Failed to export the profile!");
+}
+
+double Profiler::Microseconds(uint64_t ticks) const
+{
+    return ticks * 1000000.0 / _frequency;
+}
+
+int32_t Profiler::GraphHeight(double ms) const
+{
+    int32_t height = (int32_t)(ms / GRAPH_RANGE_MS * GRAPH_HEIGHT);
+    return height < GRAPH_HEIGHT ? height : GRAPH_HEIGHT;
+}
+
+std::vector<double> Profiler::Durations(Section section) const
+{
+    std::vector<double> durations;
+
+    for (size_t i = 0; i < _count; ++i)
+    {
+        if (_samples[i].Id == section)
+            durations.push_back(Microseconds(_samples[i].End - _samples[i].Begin) / 1000.0);
+    }
+
+    return durations;
+}
+
+double Profiler::Rank(std::vector<double>& durations, double percentile)
+{
+    if (durations.empty())
+        return 0.0;
+
+    size_t rank = std::min((size_t)std::ceil(percentile / 100.0 * durations.size()), durations.size()) - (percentile > 0.0 ? 1 : 0);
+    std::nth_element(durations.begin(), durations.begin() + rank, durations.end());
+    return durations[rank];
+}
+
+std::vector<Profiler::Sample> Profiler::Ordered() const
+{
+    std::vector<Sample> samples;
+    size_t first = _count < CAPACITY ? 0 : _next;
+
+    for (size_t i = 0; i < _count; ++i)
+        samples.push_back(_samples[(first + i) % CAPACITY]);
+
+    // nested scopes finish before the enclosing one, order by start
+    std::stable_sort(samples.begin(), samples.end(), [](const Sample& l, const Sample& r) -> bool { return l.Begin < r.Begin; });
+    return samples;
+}
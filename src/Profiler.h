@@ -0,0 +1,182 @@
+#pragma once
+
+#include "RenderManager.h"
+
+#include <ostream>
+#include <vector>
+
+/**
+ * @brief Class used for wrapping exception context from the Profiler class.
+*/
+class ProfilerException : public std::exception
+{
+private:
+    std::string _message;
+
+public:
+    /**
+     * @brief Create a new instance of the object.
+     * @param message Programmer given context.
+    */
+    inline ProfilerException(const std::string& message) : _message(message) { }
+    /**
+     * @brief Message getter.
+     * @return Exception context.
+    */
+    inline std::string Message() const { return _message; }
+    /**
+     * @brief Exception specifier.
+     * @return Exception specifier.
+    */
+    inline const char* what() const noexcept override { return "ProfilerException"; }
+};
+
+/**
+ * @brief Class used for recording frame timings into a fixed-size ring buffer.
+*/
+class Profiler
+{
+public:
+    /**
+     * @brief Enum for the measured sections.
+    */
+    enum Section { FRAME, PROCESS_EVENTS, UPDATE, COLLISION_BONUSES, COLLISION_BALL, DRAW, PRESENT, SECTION_COUNT };
+
+private:
+    static const size_t CAPACITY = 16384;
+    static const int32_t GRAPH_FRAMES = 240;
+    static const int32_t GRAPH_HEIGHT = 60;
+    static const int32_t GRAPH_RANGE_MS = 50;
+    static const uint64_t OVERLAY_INTERVAL = 30;
+
+    /**
+     * @brief Structure used for storing a single measurement.
+    */
+    struct Sample
+    {
+        uint64_t Frame;
+        uint64_t Begin;
+        uint64_t End;
+        Section Id;
+    };
+
+    bool _enabled;
+    uint64_t _frame;
+    uint64_t _origin;
+    double _frequency;
+
+    size_t _next;
+    size_t _count;
+    std::vector<Sample> _samples;
+
+    double _overlay[3]; // p50, p95 and p99 of the frame time, refreshed every OVERLAY_INTERVAL frames
+
+public:
+    /**
+     * @brief Create a new instance of the object.
+     * @param enabled Enabled flag. Disabled profiler records nothing.
+    */
+    Profiler(bool enabled);
+
+    /**
+     * @brief Enabled flag getter.
+     * @return True if recording.
+    */
+    bool IsEnabled() const;
+    /**
+     * @brief Mark the start of a new frame. Refreshes the overlay percentiles periodically, outside of the measured sections.
+    */
+    void BeginFrame();
+    /**
+     * @brief Record a measurement. The oldest measurement is overwritten once the buffer is full.
+     * @param section Measured section.
+     * @param begin Performance counter at the start of the section.
+     * @param end Performance counter at the end of the section.
+    */
+    void Record(Section section, uint64_t begin, uint64_t end);
+    /**
+     * @brief Calculate a percentile of the recorded durations.
+     * @param section Measured section.
+     * @param percentile Percentile in range 0 to 100.
+     * @return Duration in milliseconds.
+    */
+    double Percentile(Section section, double percentile) const;
+    /**
+     * @brief Draw the overlay with frame time graph and percentile lines.
+     * @param renderer Target renderer.
+     * @param x Overlay position on horizontal axis.
+     * @param y Overlay position on vertical axis.
+     * @param budget Frame budget in milliseconds.
+    */
+    void Draw(const RenderManager& renderer, int32_t x, int32_t y, double budget) const;
+    /**
+     * @brief Print percentiles of all sections.
+     * @param os Output stream.
+    */
+    void PrintSummary(std::ostream& os) const;
+    /**
+     * @brief Export the recorded measurements as CSV.
+     * @param path File path.
+    */
+    void ExportCsv(const std::string& path) const;
+    /**
+     * @brief Export the recorded measurements as Chrome trace event JSON.
+     * @param path File path.
+    */
+    void ExportTrace(const std::string& path) const;
+
+private:
+    /**
+     * @brief Convert performance counter difference to microseconds.
+     * @param ticks Performance counter difference.
+     * @return Value in microseconds.
+    */
+    double Microseconds(uint64_t ticks) const;
+    /**
+     * @brief Convert duration to the height of the graph bar.
+     * @param ms Duration in milliseconds.
+     * @return Height in pixels, clamped to the graph.
+    */
+    int32_t GraphHeight(double ms) const;
+    /**
+     * @brief Collect the recorded durations of a section.
+     * @param section Measured section.
+     * @return Durations in milliseconds.
+    */
+    std::vector<double> Durations(Section section) const;
+    /**
+     * @brief Select a percentile from the durations. The durations are partially reordered.
+     * @param durations Durations in milliseconds.
+     * @param percentile Percentile in range 0 to 100.
+     * @return Duration in milliseconds.
+    */
+    static double Rank(std::vector<double>& durations, double percentile);
+    /**
+     * @brief Collect the recorded measurements from the oldest to the newest.
+     * @return Recorded measurements.
+    */
+    std::vector<Sample> Ordered() const;
+};
+
+/**
+ * @brief Class used for measuring a scope. Costs a single branch when the profiler is disabled.
+*/
+class ScopedTimer
+{
+private:
+    Profiler& _profiler;
+    Profiler::Section _section;
+    uint64_t _begin;
+
+public:
+    /**
+     * @brief Start the measurement.
+     * @param profiler Profiler to record into.
+     * @param section Measured section.
+    */
+    inline ScopedTimer(Profiler& profiler, Profiler::Section section) : _profiler(profiler), _section(section), _begin(profiler.IsEnabled() ? SDL_GetPerformanceCounter() : 0) { }
+    /**
+     * @brief Finish the measurement.
+    */
+    inline ~ScopedTimer() { if (_begin != 0) _profiler.Record(_section, _begin, SDL_GetPerformanceCounter()); }
+};
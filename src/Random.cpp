@@ -0,0 +1,35 @@
+#include "Random.h"
+
+Random::Random(uint64_t seed)
+    : _state(0)
+{
+    Next();
+    _state += seed;
+    Next();
+}
+
+uint32_t Random::Next()
+{
+    uint64_t state = _state;
+    _state = state * MULTIPLIER + INCREMENT;
+
+    uint32_t xorshifted = (uint32_t)(((state >> 18) ^ state) >> 27);
+    uint32_t rotation = (uint32_t)(state >> 59);
+    return (xorshifted >> rotation) | (xorshifted << ((32 - rotation) & 31));
+}
+
+int32_t Random::Range(int32_t bound)
+{
+    // multiply-shift, values from the biased low part of the product are rejected
+    uint32_t range = (uint32_t)bound;
+    uint64_t product = (uint64_t)Next() * range;
+
+    if ((uint32_t)product < range)
+    {
+        uint32_t threshold = (0u - range) % range;
+        while ((uint32_t)product < threshold)
+            product = (uint64_t)Next() * range;
+    }
+
+    return (int32_t)(product >> 32);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Class used for generating pseudo random numbers. PCG32, every game owns its own state.
+*/
+class Random
+{
+private:
+    static const uint64_t MULTIPLIER = 6364136223846793005ULL;
+    static const uint64_t INCREMENT = 1442695040888963407ULL;
+
+    uint64_t _state;
+
+public:
+    /**
+     * @brief Create a new instance of the object.
+     * @param seed Seed of the sequence.
+    */
+    Random(uint64_t seed);
+    /**
+     * @brief Generate the next number of the sequence.
+     * @return Uniformly distributed 32 bit number.
+    */
+    uint32_t Next();
+    /**
+     * @brief Generate a number in range without the modulo bias.
+     * @param bound Exclusive upper bound, has to be positive.
+     * @return Uniformly distributed number in range 0 to bound - 1.
+    */
+    int32_t Range(int32_t bound);
+};
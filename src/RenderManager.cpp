@@ -1,43 +1,286 @@
 #include "RenderManager.h"
 
 RenderManager::RenderManager()
-    : _window(nullptr), _renderer(nullptr) { }
+    : _headless(false), _targets(false), _vsync(false), _generation(0), _window(nullptr), _renderer(nullptr), _origin({ 0, 0 }), _screen({ 0, 0, 0, 0 }), _onTarget(false), _camera({ 0, 0 }), _clip({ 0, 0, 0, 0 }), _view({ 0, 0, 0, 0 }), _batchTexture(nullptr), _batchSize({ 0, 0 }) { }
 
 RenderManager::~RenderManager()
 {
+    // textures have to go before their renderer
+    _textures.Clear();
     SDL_DestroyRenderer(_renderer);
     SDL_DestroyWindow(_window);
     _renderer = nullptr;
     _window = nullptr;
-    SDL_Quit();
+
+    if (!_headless)
+        SDL_Quit();
 }
 
-void RenderManager::Init(const std::string& title, int32_t x, int32_t y, int32_t width, int32_t height, bool fullscreen, Color color)
+void RenderManager::Init(const std::string& title, int32_t x, int32_t y, int32_t width, int32_t height, bool fullscreen, Color color, const RenderSettings& settings)
 {
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) // returns 0 on success 
         throw RenderManagerException("Initialiazing SDL failed!");
 
-    if ((_window = SDL_CreateWindow(title.c_str(), x, y, width, height, fullscreen ? SDL_WINDOW_FULLSCREEN : 0)) == nullptr)
+    int32_t windowWidth = settings.Width > 0 ? settings.Width : width;
+    int32_t windowHeight = settings.Height > 0 ? settings.Height : height;
+
+    if ((_window = SDL_CreateWindow(title.c_str(), x, y, windowWidth, windowHeight, fullscreen ? SDL_WINDOW_FULLSCREEN : 0)) == nullptr)
         throw RenderManagerException("Creating SDL window failed!");
 
-    if ((_renderer = SDL_CreateRenderer(_window, -1, 0)) == nullptr)
+    SDL_SetHint(SDL_HINT_RENDER_BATCHING, "1");
+
+    // -1 lets SDL pick the first driver supporting the flags
+    int index = -1;
+    SDL_RendererInfo info;
+
+    if (!settings.Driver.empty())
+    {
+        for (int i = 0; i < SDL_GetNumRenderDrivers() && index < 0; ++i)
+        {
+            if (SDL_GetRenderDriverInfo(i, &info) == 0 && settings.Driver == info.name)
+                index = i;
+        }
+
+        if (index < 0)
+            throw RenderManagerException("Unknown render driver " + settings.Driver + "!");
+    }
+
+    uint32_t flags = (settings.Software ? SDL_RENDERER_SOFTWARE : 0) | (settings.Vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+
+    if ((_renderer = SDL_CreateRenderer(_window, index, flags)) == nullptr)
         throw RenderManagerException("Creating SDL renderer failed!");
 
+    // the game is drawn at its own size and scaled to the window
+    if (SDL_RenderSetLogicalSize(_renderer, width, height) != 0)
+        throw RenderManagerException("Setting SDL logical size failed!");
+
+    // vsync isn't guaranteed, the frames have to be limited without it
+    bool described = SDL_GetRendererInfo(_renderer, &info) == 0;
+    _targets = described && (info.flags & SDL_RENDERER_TARGETTEXTURE) != 0;
+    _vsync = described && (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
+
+    // cached layers need the premultiplied blending, the software renderer doesn't support it and the layers are drawn directly
+    _targets = _targets && CreateTarget(1, 1) != nullptr;
+
     SetClearColor(color);
+
+    _screen = { 0, 0, width, height };
+    _clip = _screen;
+    UpdateView();
+}
+
+void RenderManager::InitHeadless()
+{
+    _headless = true;
+}
+
+void RenderManager::Draw(SDL_Texture* texture, const SDL_Rect& source, const SDL_Rect& rectangle) const
+{
+    if (_headless || texture == nullptr)
+        return;
+
+    if (texture != _batchTexture)
+    {
+        Flush();
+        _batchTexture = texture;
+        SDL_QueryTexture(texture, nullptr, nullptr, &_batchSize.x, &_batchSize.y);
+    }
+
+    float u0 = (float)source.x / _batchSize.x;
+    float v0 = (float)source.y / _batchSize.y;
+    float u1 = (float)(source.x + source.w) / _batchSize.x;
+    float v1 = (float)(source.y + source.h) / _batchSize.y;
+
+    float x0 = (float)(rectangle.x - _origin.x);
+    float y0 = (float)(rectangle.y - _origin.y);
+    float x1 = x0 + rectangle.w;
+    float y1 = y0 + rectangle.h;
+
+    int first = (int)_vertices.size();
+    _vertices.push_back({ { x0, y0 }, { 255, 255, 255, 255 }, { u0, v0 } });
+    _vertices.push_back({ { x1, y0 }, { 255, 255, 255, 255 }, { u1, v0 } });
+    _vertices.push_back({ { x1, y1 }, { 255, 255, 255, 255 }, { u1, v1 } });
+    _vertices.push_back({ { x0, y1 }, { 255, 255, 255, 255 }, { u0, v1 } });
+
+    for (int index : { 0, 1, 2, 0, 2, 3 })
+        _indices.push_back(first + index);
+}
+
+void RenderManager::Draw(TextureHandle texture, const SDL_Rect& rectangle) const
+{
+    const Texture* resolved = _textures.Get(texture);
+
+    if (resolved != nullptr)
+        Draw(resolved->GetTexture(), resolved->GetSource(), rectangle);
+}
+
+TextureHandle RenderManager::Register(const std::shared_ptr<Texture>& texture)
+{
+    return _textures.Add(texture);
+}
+
+void RenderManager::Flush() const
+{
+    if (_headless)
+        return;
+
+    if (!_vertices.empty())
+    {
+        SDL_RenderGeometry(_renderer, _batchTexture, _vertices.data(), (int)_vertices.size(), _indices.data(), (int)_indices.size());
+
+        _vertices.clear();
+        _indices.clear();
+    }
+
+    // a destroyed texture can be replaced by a new one at the same address, the size is queried again for the next batch
+    _batchTexture = nullptr;
+}
+
+std::shared_ptr<Texture> RenderManager::CreateTarget(int32_t width, int32_t height) const
+{
+    if (_headless)
+        return std::make_shared<Texture>(nullptr);
+
+    SDL_Texture* target = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+
+    if (target == nullptr)
+        throw RenderManagerException("Creating SDL render target failed!");
+
+    // sprites blended onto a transparent target end up premultiplied, the plain blending would apply the alpha twice
+    if (SDL_SetTextureBlendMode(target, SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD, SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD)) != 0)
+    {
+        SDL_DestroyTexture(target);
+        return nullptr;
+    }
+
+    return std::make_shared<Texture>(target);
+}
+
+void RenderManager::SetTarget(SDL_Texture* target, int32_t x, int32_t y) const
+{
+    if (_headless)
+        return;
+
+    Flush();
+
+    if (SDL_SetRenderTarget(_renderer, target) != 0)
+        throw RenderManagerException("Setting up SDL render target failed!");
+
+    _onTarget = target != nullptr;
+
+    if (!_onTarget)
+    {
+        UpdateView();
+        return;
+    }
+
+    int32_t width, height;
+    SDL_QueryTexture(target, nullptr, nullptr, &width, &height);
+
+    _origin = { x, y };
+    _view = { x, y, width, height };
 }
 
-void RenderManager::Draw(SDL_Texture* texture, const SDL_Rect& rectangle) const
+void RenderManager::SetCamera(int32_t x, int32_t y) const
 {
-    SDL_RenderCopy(_renderer, texture, nullptr, &rectangle);
+    if (_headless)
+        return;
+
+    _camera = { x, y };
+
+    if (!_onTarget)
+        UpdateView();
+}
+
+void RenderManager::SetClip(const SDL_Rect* rectangle) const
+{
+    if (_headless)
+        return;
+
+    Flush();
+
+    if (SDL_RenderSetClipRect(_renderer, rectangle) != 0)
+        throw RenderManagerException("Setting up SDL clip rectangle failed!");
+
+    _clip = rectangle != nullptr ? *rectangle : _screen;
+
+    if (!_onTarget)
+        UpdateView();
+}
+
+SDL_Rect RenderManager::GetView() const
+{
+    return _view;
+}
+
+void RenderManager::UpdateView() const
+{
+    _origin = _camera;
+    _view = { _camera.x + _clip.x, _camera.y + _clip.y, _clip.w, _clip.h };
+}
+
+void RenderManager::ClearRect(const SDL_Rect& rectangle, Color color) const
+{
+    Fill(rectangle, color, SDL_BLENDMODE_NONE);
+}
+
+void RenderManager::FillRect(const SDL_Rect& rectangle, Color color) const
+{
+    Fill(rectangle, color, SDL_BLENDMODE_BLEND);
+}
+
+void RenderManager::Fill(const SDL_Rect& rectangle, Color color, SDL_BlendMode mode) const
+{
+    if (_headless)
+        return;
+
+    Flush();
+
+    Color previous;
+    SDL_GetRenderDrawColor(_renderer, &previous.R, &previous.G, &previous.B, &previous.A);
+
+    SDL_Rect translated = { rectangle.x - _origin.x, rectangle.y - _origin.y, rectangle.w, rectangle.h };
+    SDL_SetRenderDrawBlendMode(_renderer, mode);
+    SDL_SetRenderDrawColor(_renderer, color.R, color.G, color.B, color.A);
+    SDL_RenderFillRect(_renderer, &translated);
+    SDL_SetRenderDrawColor(_renderer, previous.R, previous.G, previous.B, previous.A);
+}
+
+std::string RenderManager::GetDescription() const
+{
+    SDL_RendererInfo info;
+
+    if (_headless)
+        return "headless";
+
+    if (SDL_GetRendererInfo(_renderer, &info) != 0)
+        return "unknown renderer";
+
+    const char* video = SDL_GetCurrentVideoDriver();
+
+    return std::string(info.name) + " on " + (video ? video : "unknown video") + ((info.flags & SDL_RENDERER_ACCELERATED) ? ", accelerated" : ", software") + ((info.flags & SDL_RENDERER_PRESENTVSYNC) ? ", vsync" : "");
+}
+
+void RenderManager::InvalidateTargets()
+{
+    ++_generation;
 }
 
 void RenderManager::Clear() const
 {
+    if (_headless)
+        return;
+
+    Flush();
     SDL_RenderClear(_renderer);
 }
 
 void RenderManager::Present() const
 {
+    if (_headless)
+        return;
+
+    Flush();
     SDL_RenderPresent(_renderer);
 }
 
@@ -47,9 +290,29 @@ void RenderManager::SetClearColor(Color color) const
         throw RenderManagerException("Setting up SDL clear color failed!");
 }
 
+bool RenderManager::SupportsTargets() const
+{
+    return _targets || _headless;
+}
+
+uint32_t RenderManager::GetGeneration() const
+{
+    return _generation;
+}
+
+bool RenderManager::IsVsync() const
+{
+    return _vsync;
+}
+
+bool RenderManager::IsHeadless() const
+{
+    return _headless;
+}
+
 SDL_Renderer* RenderManager::GetRenderer() const
 {
-    if (_renderer == nullptr)
+    if (_renderer == nullptr && !_headless)
         throw RenderManagerException("SDL renderer is not initialized!");
 
     return _renderer;
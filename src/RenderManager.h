@@ -1,9 +1,11 @@
 #pragma once
 
 #include "Utility.h"
+#include "TextureLoader.h"
 
 #include <SDL2/SDL.h>
 #include <string>
+#include <vector>
 
 /**
  * @brief Class used for wrapping exception context from the RenderManager class.
@@ -32,14 +34,48 @@ public:
     inline const char* what() const noexcept override { return "RenderManagerException"; }
 };
 
+/**
+ * @brief Structure used for storing the renderer configuration.
+*/
+struct RenderSettings
+{
+    std::string Driver; // SDL render driver, empty for the first one supporting the flags
+    bool Software; // software renderer instead of an accelerated one
+    bool Vsync; // present waits for the vertical retrace
+    int32_t Width; // window size, zero for the size of the game, the game is scaled to the window
+    int32_t Height;
+};
+
 /**
  * @brief Class used for rendering. Wrapper around the SDL_Window & the SDL_Renderer functionality.
+ * Draw calls sharing a texture are batched and submitted as a single geometry call.
  */
 class RenderManager
 {
 private:
+    bool _headless;
+    bool _targets;
+    bool _vsync;
+    uint32_t _generation;
     SDL_Window* _window;
     SDL_Renderer* _renderer;
+    TextureRegistry _textures;
+
+    // translation of the draw calls into the current render target
+    mutable SDL_Point _origin;
+
+    // scrolled position of the window and the visible part of the current target
+    SDL_Rect _screen;
+    mutable bool _onTarget;
+    mutable SDL_Point _camera;
+    mutable SDL_Rect _clip;
+    mutable SDL_Rect _view;
+
+    // pending batch, submitted on texture change or present
+    mutable SDL_Texture* _batchTexture;
+    mutable SDL_Point _batchSize;
+    mutable std::vector<SDL_Vertex> _vertices;
+    mutable std::vector<int> _indices;
 
 public:
     /**
@@ -56,18 +92,91 @@ public:
      * @param title Window title.
      * @param x Window position on horizontal axis.
      * @param y Window position on vertical axis.
-     * @param width Window width.
-     * @param height Window height.
+     * @param width Logical width, all the draw calls use the logical size.
+     * @param height Logical height.
      * @param fullscreen Fullscreen flag.
      * @param color Window clear color.
+     * @param settings Renderer configuration.
+     */
+    void Init(const std::string& title, int32_t x, int32_t y, int32_t width, int32_t height, bool fullscreen, Color color, const RenderSettings& settings);
+    /**
+     * @brief Initialize null context. No SDL context is created and all the draw calls are discarded.
      */
-    void Init(const std::string& title, int32_t x, int32_t y, int32_t width, int32_t height, bool fullscreen, Color color);
+    void InitHeadless();
     /**
      * @brief Buffer SDL draw data.
      * @param texture Texture to be drawn.
+     * @param source Region of the texture to be drawn.
+     * @param rectangle Rectangle to be drawn to.
+     */
+    void Draw(SDL_Texture* texture, const SDL_Rect& source, const SDL_Rect& rectangle) const;
+    /**
+     * @brief Buffer SDL draw data of a registered texture.
+     * @param texture Handle of the texture, no texture is skipped.
      * @param rectangle Rectangle to be drawn to.
      */
-    void Draw(SDL_Texture* texture, const SDL_Rect& rectangle) const;
+    void Draw(TextureHandle texture, const SDL_Rect& rectangle) const;
+    /**
+     * @brief Register a texture to be drawn by its handle. The texture is kept until the renderer is destroyed.
+     * @param texture Smart pointer to the Texture object.
+     * @return Handle of the texture.
+    */
+    TextureHandle Register(const std::shared_ptr<Texture>& texture);
+    /**
+     * @brief Submit the buffered SDL draw data.
+    */
+    void Flush() const;
+    /**
+     * @brief Create a texture usable as a render target. Contents are expected to be premultiplied by alpha.
+     * @param width Texture width.
+     * @param height Texture height.
+     * @return Smart pointer to the Texture object, empty texture for null context, null pointer if the renderer can't blend premultiplied textures.
+    */
+    std::shared_ptr<Texture> CreateTarget(int32_t width, int32_t height) const;
+    /**
+     * @brief Redirect the draw calls into a render target.
+     * @param target Render target, null pointer for the window.
+     * @param x Position of the target on horizontal axis, the window uses the camera instead.
+     * @param y Position of the target on vertical axis, the window uses the camera instead.
+    */
+    void SetTarget(SDL_Texture* target, int32_t x, int32_t y) const;
+    /**
+     * @brief Scroll the window. Draw calls into the window are translated by the camera position.
+     * @param x Camera position on horizontal axis.
+     * @param y Camera position on vertical axis.
+    */
+    void SetCamera(int32_t x, int32_t y) const;
+    /**
+     * @brief Restrict the draw calls into the window to a rectangle.
+     * @param rectangle Rectangle in window coordinates, null pointer for the whole window.
+    */
+    void SetClip(const SDL_Rect* rectangle) const;
+    /**
+     * @brief Visible rectangle getter. Objects outside of it don't have to be drawn.
+     * @return Visible part of the current target in the translated coordinates, empty for null context.
+    */
+    SDL_Rect GetView() const;
+    /**
+     * @brief Overwrite a rectangle of the current target with the color. No blending is applied.
+     * @param rectangle Rectangle to be cleared.
+     * @param color Color to fill the rectangle with.
+    */
+    void ClearRect(const SDL_Rect& rectangle, Color color) const;
+    /**
+     * @brief Fill a rectangle of the current target with the color blended over the content.
+     * @param rectangle Rectangle to be filled.
+     * @param color Color to fill the rectangle with.
+    */
+    void FillRect(const SDL_Rect& rectangle, Color color) const;
+    /**
+     * @brief Describe the renderer configuration.
+     * @return Name of the render driver, the video driver and the renderer flags.
+    */
+    std::string GetDescription() const;
+    /**
+     * @brief Mark all render targets as lost. Happens on device reset.
+    */
+    void InvalidateTargets();
     /**
      * @brief Clear screen.
     */
@@ -81,10 +190,43 @@ public:
      * @param color Desired clear color.
     */
     void SetClearColor(Color color) const;
+    /**
+     * @brief Render target support getter.
+     * @return True if render targets with premultiplied blending can be used.
+    */
+    bool SupportsTargets() const;
+    /**
+     * @brief Render target generation getter. Changes whenever the render targets are lost.
+     * @return Value of the generation.
+    */
+    uint32_t GetGeneration() const;
+    /**
+     * @brief Vsync flag getter.
+     * @return True if the present waits for the vertical retrace.
+    */
+    bool IsVsync() const;
+    /**
+     * @brief Headless flag getter.
+     * @return True if initialized with null context.
+    */
+    bool IsHeadless() const;
     /**
      * @brief Renderer getter.
-     * @return Pointer to the initialized renderer.
+     * @return Pointer to the initialized renderer, null pointer for null context.
     */
     SDL_Renderer* GetRenderer() const;
+
+private:
+    /**
+     * @brief Apply the camera and the clip rectangle to the window translation.
+    */
+    void UpdateView() const;
+    /**
+     * @brief Fill a rectangle with the color using the blend mode.
+     * @param rectangle Rectangle to be filled.
+     * @param color Color to fill the rectangle with.
+     * @param mode Blend mode.
+    */
+    void Fill(const SDL_Rect& rectangle, Color color, SDL_BlendMode mode) const;
 };
 
@@ -0,0 +1,182 @@
+#include "Replay.h"
+
+#include <fstream>
+#include <climits>
+#include <algorithm>
+
+// replay layout - header, map path and input runs, each run is a key bitmask, held steps of the left and right arrow and LEB128 length
+// version 1 runs have no held steps, the keys are held for the whole tick
+static const char REPLAY_MAGIC[4] = { 'R', 'V', 'R', 'P' };
+static const uint32_t REPLAY_VERSION = 2;
+
+struct ReplayHeader
+{
+    char Magic[4];
+    uint32_t Version;
+    uint32_t Seed;
+    int32_t Score;
+    uint64_t Ticks;
+    uint32_t Runs;
+    uint32_t MapLength;
+};
+
+Replay::Replay(uint32_t seed, const std::string& mapPath)
+    : _seed(seed), _score(0), _ticks(0), _mapPath(mapPath), _run(0), _position(0) { }
+
+void Replay::Record(const InputHandler& input)
+{
+    uint8_t keys = 0;
+    for (int32_t i = 0; i < InputHandler::KEYS_COUNT; ++i)
+        keys |= input.KeyMap[i] ? 1 << i : 0;
+
+    uint8_t left = (uint8_t)input.Held[InputHandler::KEY_LEFT_ARROW];
+    uint8_t right = (uint8_t)input.Held[InputHandler::KEY_RIGHT_ARROW];
+
+    if (_runs.empty() || _runs.back().Keys != keys || _runs.back().Left != left || _runs.back().Right != right)
+        _runs.push_back({ keys, left, right, 0 });
+
+    ++_runs.back().Length;
+    ++_ticks;
+}
+
+bool Replay::Next(InputHandler& input)
+{
+    if (_run < _runs.size() && _position == _runs[_run].Length)
+    {
+        ++_run;
+        _position = 0;
+    }
+
+    if (_run == _runs.size())
+        return false;
+
+    for (int32_t i = 0; i < InputHandler::KEYS_COUNT; ++i)
+        input.Set(i, _runs[_run].Keys & (1 << i));
+
+    input.Held[InputHandler::KEY_LEFT_ARROW] = _runs[_run].Left;
+    input.Held[InputHandler::KEY_RIGHT_ARROW] = _runs[_run].Right;
+
+    ++_position;
+    return true;
+}
+
+void Replay::Save(const std::string& path, int32_t score)
+{
+    _score = score;
+
+    std::ofstream ofs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (ofs.fail())
+        throw ReplayException("Failed to initialize output file stream!");
+
+    ReplayHeader header = { { 0 }, REPLAY_VERSION, _seed, _score, _ticks, (uint32_t)_runs.size(), (uint32_t)_mapPath.size() };
+    std::copy(REPLAY_MAGIC, REPLAY_MAGIC + 4, header.Magic);
+
+    ofs.write((const char*)&header, sizeof(header));
+    ofs.write(_mapPath.data(), _mapPath.size());
+
+    for (const Run& run : _runs)
+    {
+        ofs.put((char)run.Keys);
+        ofs.put((char)run.Left);
+        ofs.put((char)run.Right);
+
+        uint64_t length = run.Length;
+        do
+        {
+            ofs.put((char)((length & 0x7F) | (length > 0x7F ? 0x80 : 0)));
+            length >>= 7;
+        } while (length != 0);
+    }
+
+    if (!ofs)
+        throw ReplayException("Failed to save the replay!");
+}
+
+Replay Replay::Load(const std::string& path)
+{
+    std::ifstream ifs(path, std::ios::in | std::ios::binary);
+
+    if (ifs.fail())
+        throw ReplayException("Failed to initialize input file stream!");
+
+    ReplayHeader header;
+    if (!ifs.read((char*)&header, sizeof(header)) || !std::equal(REPLAY_MAGIC, REPLAY_MAGIC + 4, header.Magic))
+        throw ReplayException("Invalid replay file!");
+
+    if (header.Version != 1 && header.Version != REPLAY_VERSION)
+        throw ReplayException("Unsupported replay version!");
+
+    // the length is bounded before allocating, a corrupted header can't request gigabytes
+    std::streampos start = ifs.tellg();
+    ifs.seekg(0, std::ios::end);
+    std::streamoff remaining = ifs.tellg() - start;
+    ifs.seekg(start);
+
+    if (header.MapLength > PATH_MAX || (std::streamoff)header.MapLength > remaining)
+        throw ReplayException("Corrupted replay file!");
+
+    std::string mapPath(header.MapLength, '\0');
+    if (!ifs.read(&mapPath[0], header.MapLength))
+        throw ReplayException("Invalid replay file!");
+
+    Replay replay(header.Seed, mapPath);
+    replay._score = header.Score;
+
+    for (uint32_t i = 0; i < header.Runs; ++i)
+    {
+        int keys = ifs.get();
+        int left = keys & (1 << InputHandler::KEY_LEFT_ARROW) ? InputHandler::HELD_STEPS : 0;
+        int right = keys & (1 << InputHandler::KEY_RIGHT_ARROW) ? InputHandler::HELD_STEPS : 0;
+
+        if (header.Version != 1)
+        {
+            left = ifs.get();
+            right = ifs.get();
+        }
+
+        uint64_t length = 0;
+        int byte;
+
+        for (int32_t shift = 0; (byte = ifs.get()) != EOF && shift < 64; shift += 7)
+        {
+            length |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+
+        if (keys == EOF || left == EOF || right == EOF || byte == EOF || byte & 0x80 || length == 0)
+            throw ReplayException("Truncated replay file!");
+
+        if (left > InputHandler::HELD_STEPS || right > InputHandler::HELD_STEPS)
+            throw ReplayException("Corrupted replay file!");
+
+        replay._runs.push_back({ (uint8_t)keys, (uint8_t)left, (uint8_t)right, length });
+        replay._ticks += length;
+    }
+
+    if (replay._ticks != header.Ticks)
+        throw ReplayException("Corrupted replay file!");
+
+    return replay;
+}
+
+uint32_t Replay::GetSeed() const
+{
+    return _seed;
+}
+
+int32_t Replay::GetScore() const
+{
+    return _score;
+}
+
+uint64_t Replay::GetTicks() const
+{
+    return _ticks;
+}
+
+std::string Replay::GetMapPath() const
+{
+    return _mapPath;
+}
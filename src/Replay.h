@@ -0,0 +1,112 @@
+#pragma once
+
+#include "InputHandler.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Class used for wrapping exception context from the Replay class.
+*/
+class ReplayException : public std::exception
+{
+private:
+    std::string _message;
+
+public:
+    /**
+     * @brief Create a new instance of the object.
+     * @param message Programmer given context.
+    */
+    inline ReplayException(const std::string& message) : _message(message) { }
+    /**
+     * @brief Message getter.
+     * @return Exception context.
+    */
+    inline std::string Message() const { return _message; }
+    /**
+     * @brief Exception specifier.
+     * @return Exception specifier.
+    */
+    inline const char* what() const noexcept override { return "ReplayException"; }
+};
+
+/**
+ * @brief Class used for recording and playing back the input state of every tick.
+*/
+class Replay
+{
+private:
+    /**
+     * @brief Structure used for storing a run of ticks with the same input state.
+    */
+    struct Run
+    {
+        uint8_t Keys;
+        uint8_t Left; // held steps of the arrows
+        uint8_t Right;
+        uint64_t Length;
+    };
+
+    uint32_t _seed;
+    int32_t _score;
+    uint64_t _ticks;
+    std::string _mapPath;
+    std::vector<Run> _runs;
+
+    size_t _run;
+    uint64_t _position;
+
+public:
+    /**
+     * @brief Create a new empty recording.
+     * @param seed Random seed of the recorded game.
+     * @param mapPath Map file path of the recorded game.
+    */
+    Replay(uint32_t seed, const std::string& mapPath);
+
+    /**
+     * @brief Append the input state of a tick.
+     * @param input Input state to record.
+    */
+    void Record(const InputHandler& input);
+    /**
+     * @brief Read the input state of the next tick.
+     * @param input Input state to overwrite.
+     * @return False if the recording is exhausted.
+    */
+    bool Next(InputHandler& input);
+    /**
+     * @brief Save the recording.
+     * @param path Replay file path.
+     * @param score Final score of the recorded game, used to verify the playback.
+    */
+    void Save(const std::string& path, int32_t score);
+    /**
+     * @brief Load a recording.
+     * @param path Replay file path.
+     * @return Loaded recording positioned at the first tick.
+    */
+    static Replay Load(const std::string& path);
+
+    /**
+     * @brief Random seed getter.
+     * @return Value of the random seed.
+    */
+    uint32_t GetSeed() const;
+    /**
+     * @brief Final score getter.
+     * @return Value of the final score.
+    */
+    int32_t GetScore() const;
+    /**
+     * @brief Tick count getter.
+     * @return Number of recorded ticks.
+    */
+    uint64_t GetTicks() const;
+    /**
+     * @brief Map file path getter.
+     * @return Value of the map file path.
+    */
+    std::string GetMapPath() const;
+};
@@ -1,27 +1,480 @@
 #include "TextureLoader.h"
+#include "Utility.h"
 
-Texture::Texture(SDL_Texture* texture)
-    : _texture(texture) { }
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+
+// asset pack layout - header, page table, sprite table and page pixels aligned to PACK_ALIGNMENT
+static const char PACK_MAGIC[4] = { 'R', 'V', 'P', 'K' };
+static const uint32_t PACK_VERSION = 2;
+static const uint32_t PACK_ALIGNMENT = 64;
+static const size_t PACK_PATH_LENGTH = 104;
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ull;
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+struct PackHeader
+{
+    char Magic[4];
+    uint32_t Version;
+    uint32_t Format; // SDL pixel format of the pages
+    uint32_t Pages;
+    uint32_t Sprites;
+    uint32_t Reserved;
+};
+
+struct PackPage
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Pitch;
+    uint32_t Reserved;
+    uint64_t Offset;
+};
+
+struct PackSprite
+{
+    char Path[PACK_PATH_LENGTH];
+    uint32_t Page;
+    int32_t X;
+    int32_t Y;
+    int32_t Width;
+    int32_t Height;
+    uint32_t Reserved;
+    uint64_t SourceHash; // content of the source file when baked
+};
 
-Texture::~Texture()
+Texture::Texture(SDL_Texture* texture)
+    : _texture(texture, [](SDL_Texture* t) { if (t != nullptr) SDL_DestroyTexture(t); }), _source({ 0, 0, 0, 0 })
 {
-    SDL_DestroyTexture(_texture);
-    _texture = nullptr;
+    if (texture != nullptr)
+        SDL_QueryTexture(texture, nullptr, nullptr, &_source.w, &_source.h);
 }
 
+Texture::Texture(const std::shared_ptr<SDL_Texture>& atlas, const SDL_Rect& source)
+    : _texture(atlas), _source(source) { }
+
 SDL_Texture* Texture::GetTexture() const
 {
-    return _texture;
+    return _texture.get();
+}
+
+const SDL_Rect& Texture::GetSource() const
+{
+    return _source;
+}
+
+TextureRegistry::TextureRegistry()
+    : _textures(1) { }
+
+TextureHandle TextureRegistry::Add(const std::shared_ptr<Texture>& texture)
+{
+    _textures.push_back(texture);
+    return (TextureHandle)(_textures.size() - 1);
+}
+
+void TextureRegistry::Clear()
+{
+    _textures.resize(1);
 }
 
 std::shared_ptr<Texture> TextureLoader::Load(const std::string& path, SDL_Renderer* renderer)
 {
-    SDL_Surface* surface = IMG_Load(path.c_str());
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-    SDL_FreeSurface(surface); // free surface before possibble exception
+    auto cached = _cache.find(path);
+
+    if (cached != _cache.end())
+        return cached->second;
+
+    // null context - nothing is ever drawn
+    if (renderer == nullptr)
+        return _cache[path] = std::make_shared<Texture>(nullptr);
+
+    Surface surface = std::move(Decode({ path })[0]);
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface.get());
 
     if (texture == nullptr)
         throw TextureLoaderException("Loading texture has failed!");
 
-    return std::make_shared<Texture>(texture);
+    return _cache[path] = std::make_shared<Texture>(texture);
+}
+
+std::vector<std::shared_ptr<Texture>> TextureLoader::LoadAtlas(const std::vector<std::string>& paths, SDL_Renderer* renderer)
+{
+    std::vector<std::string> missing;
+
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        if (_cache.find(paths[i]) == _cache.end() && std::find(missing.begin(), missing.end(), paths[i]) == missing.end())
+            missing.push_back(paths[i]);
+    }
+
+    // null context - nothing is ever drawn
+    if (renderer == nullptr)
+    {
+        for (size_t i = 0; i < missing.size(); ++i)
+            _cache[missing[i]] = std::make_shared<Texture>(nullptr);
+    }
+    else if (!missing.empty())
+    {
+        std::vector<Surface> surfaces = Decode(missing);
+
+        // renderers report zero for no limit
+        SDL_RendererInfo info = {};
+        SDL_GetRendererInfo(renderer, &info);
+        int32_t maxWidth = info.max_texture_width > 0 && info.max_texture_width < ATLAS_MAX_SIZE ? info.max_texture_width : ATLAS_MAX_SIZE;
+        int32_t maxHeight = info.max_texture_height > 0 && info.max_texture_height < ATLAS_MAX_SIZE ? info.max_texture_height : ATLAS_MAX_SIZE;
+
+        std::vector<int32_t> pages;
+        std::vector<SDL_Rect> regions;
+        std::vector<Surface> composed = Compose(surfaces, maxWidth, maxHeight, pages, regions);
+
+        // upload each page once
+        std::vector<std::shared_ptr<SDL_Texture>> atlases;
+
+        for (size_t i = 0; i < composed.size(); ++i)
+        {
+            SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, composed[i].get());
+
+            if (texture == nullptr)
+                throw TextureLoaderException("Creating texture atlas has failed!");
+
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+            atlases.push_back(std::shared_ptr<SDL_Texture>(texture, SDL_DestroyTexture));
+        }
+
+        for (size_t i = 0; i < missing.size(); ++i)
+            _cache[missing[i]] = std::make_shared<Texture>(atlases[pages[i]], regions[i]);
+    }
+
+    std::vector<std::shared_ptr<Texture>> textures;
+
+    for (size_t i = 0; i < paths.size(); ++i)
+        textures.push_back(_cache[paths[i]]);
+
+    return textures;
+}
+
+bool TextureLoader::LoadPack(const std::string& path, SDL_Renderer* renderer)
+{
+    if (renderer == nullptr)
+        return false;
+
+    MappedFile file(path);
+
+    if (!file.IsOpen() || file.GetSize() < sizeof(PackHeader))
+        return false;
+
+    const uint8_t* data = file.GetData();
+    const PackHeader* header = (const PackHeader*)data;
+
+    if (std::memcmp(header->Magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || header->Version != PACK_VERSION)
+        return false;
+
+    // 32-bit counts times the entry sizes can't overflow 64 bits
+    if (file.GetSize() < sizeof(PackHeader) + (uint64_t)header->Pages * sizeof(PackPage) + (uint64_t)header->Sprites * sizeof(PackSprite))
+        return false;
+
+    const PackPage* pages = (const PackPage*)(data + sizeof(PackHeader));
+    const PackSprite* sprites = (const PackSprite*)(data + sizeof(PackHeader) + header->Pages * sizeof(PackPage));
+
+    SDL_RendererInfo info = {};
+    SDL_GetRendererInfo(renderer, &info);
+
+    // validate everything before touching the renderer
+    for (uint32_t i = 0; i < header->Pages; ++i)
+    {
+        // compared against the rest of the file so a huge offset can't wrap around
+        if (pages[i].Offset > file.GetSize() || (uint64_t)pages[i].Pitch * pages[i].Height > file.GetSize() - pages[i].Offset)
+            return false;
+
+        if (pages[i].Pitch < (uint64_t)pages[i].Width * SDL_BYTESPERPIXEL(header->Format))
+            return false;
+
+        if ((info.max_texture_width > 0 && (int32_t)pages[i].Width > info.max_texture_width) || (info.max_texture_height > 0 && (int32_t)pages[i].Height > info.max_texture_height))
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header->Sprites; ++i)
+    {
+        if (sprites[i].Page >= header->Pages || std::memchr(sprites[i].Path, '\0', PACK_PATH_LENGTH) == nullptr)
+            return false;
+
+        const PackSprite& sprite = sprites[i];
+        const PackPage& page = pages[sprite.Page];
+
+        if (sprite.X < 0 || sprite.Y < 0 || sprite.Width < 0 || sprite.Height < 0 ||
+            (int64_t)sprite.X + sprite.Width > (int64_t)page.Width || (int64_t)sprite.Y + sprite.Height > (int64_t)page.Height)
+            return false;
+    }
+
+    // upload straight from the mapping
+    std::vector<std::shared_ptr<SDL_Texture>> atlases;
+
+    for (uint32_t i = 0; i < header->Pages; ++i)
+    {
+        SDL_Texture* texture = SDL_CreateTexture(renderer, header->Format, SDL_TEXTUREACCESS_STATIC, pages[i].Width, pages[i].Height);
+
+        if (texture == nullptr)
+            throw TextureLoaderException("Creating texture atlas has failed!");
+
+        atlases.push_back(std::shared_ptr<SDL_Texture>(texture, SDL_DestroyTexture));
+
+        if (SDL_UpdateTexture(texture, nullptr, data + pages[i].Offset, pages[i].Pitch) != 0)
+            throw TextureLoaderException("Uploading texture atlas has failed!");
+
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    }
+
+    for (uint32_t i = 0; i < header->Sprites; ++i)
+    {
+        // changed sources are decoded again, a missing source leaves the pack as the only copy
+        uint64_t hash;
+        if (HashSource(sprites[i].Path, hash) && hash != sprites[i].SourceHash)
+            continue;
+
+        _cache[sprites[i].Path] = std::make_shared<Texture>(atlases[sprites[i].Page], SDL_Rect{ sprites[i].X, sprites[i].Y, sprites[i].Width, sprites[i].Height });
+    }
+
+    return true;
+}
+
+void TextureLoader::Bake(const std::vector<std::string>& paths, const std::string& output)
+{
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        if (paths[i].size() >= PACK_PATH_LENGTH)
+            throw TextureLoaderException("Texture path " + paths[i] + " is too long for the asset pack!", "");
+    }
+
+    std::vector<Surface> surfaces = Decode(paths);
+    std::vector<int32_t> pages;
+    std::vector<SDL_Rect> regions;
+    std::vector<Surface> composed = Compose(surfaces, ATLAS_MAX_SIZE, ATLAS_MAX_SIZE, pages, regions);
+
+    PackHeader header = {};
+    std::memcpy(header.Magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.Version = PACK_VERSION;
+    header.Format = SDL_PIXELFORMAT_ARGB8888;
+    header.Pages = (uint32_t)composed.size();
+    header.Sprites = (uint32_t)paths.size();
+
+    std::vector<PackPage> pageTable(composed.size());
+    uint64_t offset = sizeof(PackHeader) + pageTable.size() * sizeof(PackPage) + paths.size() * sizeof(PackSprite);
+
+    for (size_t i = 0; i < composed.size(); ++i)
+    {
+        offset = (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+        pageTable[i] = { (uint32_t)composed[i]->w, (uint32_t)composed[i]->h, (uint32_t)composed[i]->w * 4, 0, offset };
+        offset += (uint64_t)pageTable[i].Pitch * pageTable[i].Height;
+    }
+
+    std::vector<PackSprite> spriteTable(paths.size());
+
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        std::memset(&spriteTable[i], 0, sizeof(PackSprite));
+        std::memcpy(spriteTable[i].Path, paths[i].c_str(), paths[i].size());
+        spriteTable[i].Page = (uint32_t)pages[i];
+        spriteTable[i].X = regions[i].x;
+        spriteTable[i].Y = regions[i].y;
+        spriteTable[i].Width = regions[i].w;
+        spriteTable[i].Height = regions[i].h;
+
+        if (!HashSource(paths[i], spriteTable[i].SourceHash))
+            throw TextureLoaderException("Failed to read texture " + paths[i] + "!", "");
+    }
+
+    std::ofstream ofs(output, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (ofs.fail())
+        throw TextureLoaderException("Failed to create asset pack " + output + "!", "");
+
+    ofs.write((const char*)&header, sizeof(header));
+    ofs.write((const char*)pageTable.data(), pageTable.size() * sizeof(PackPage));
+    ofs.write((const char*)spriteTable.data(), spriteTable.size() * sizeof(PackSprite));
+
+    for (size_t i = 0; i < composed.size(); ++i)
+    {
+        // pad up to the page offset, rows are written without the surface pitch padding
+        std::string padding(pageTable[i].Offset - (uint64_t)ofs.tellp(), '\0');
+        ofs.write(padding.data(), padding.size());
+
+        for (int32_t y = 0; y < composed[i]->h; ++y)
+            ofs.write((const char*)composed[i]->pixels + y * composed[i]->pitch, pageTable[i].Pitch);
+    }
+
+    if (!ofs)
+        throw TextureLoaderException("Failed to write asset pack " + output + "!", "");
+}
+
+std::vector<SDL_Rect> TextureLoader::Pack(const std::vector<SDL_Point>& sizes, int32_t pageWidth, int32_t pageHeight, std::vector<int32_t>& pages, std::vector<SDL_Point>& pageSizes)
+{
+    std::vector<SDL_Rect> regions(sizes.size());
+    pages.assign(sizes.size(), 0);
+    pageSizes.clear();
+
+    // tallest first keeps the shelves tight
+    std::vector<size_t> order(sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sizes](size_t l, size_t r) -> bool { return sizes[l].y > sizes[r].y; });
+
+    int32_t page = -1;
+    int32_t shelfX = 0;
+    int32_t shelfY = 0;
+    int32_t shelfHeight = 0;
+
+    for (size_t i : order)
+    {
+        int32_t width = sizes[i].x + ATLAS_PADDING;
+        int32_t height = sizes[i].y + ATLAS_PADDING;
+
+        // oversized rectangles get a page of their own
+        if (width > pageWidth || height > pageHeight)
+        {
+            pages[i] = (int32_t)pageSizes.size();
+            regions[i] = { 0, 0, sizes[i].x, sizes[i].y };
+            pageSizes.push_back({ sizes[i].x, sizes[i].y });
+            continue;
+        }
+
+        // next shelf
+        if (page >= 0 && shelfX + width > pageWidth)
+        {
+            shelfX = 0;
+            shelfY += shelfHeight;
+            shelfHeight = 0;
+        }
+
+        // next page
+        if (page < 0 || shelfY + height > pageHeight)
+        {
+            page = (int32_t)pageSizes.size();
+            pageSizes.push_back({ 0, 0 });
+            shelfX = 0;
+            shelfY = 0;
+            shelfHeight = 0;
+        }
+
+        pages[i] = page;
+        regions[i] = { shelfX, shelfY, sizes[i].x, sizes[i].y };
+        pageSizes[page].x = std::max(pageSizes[page].x, shelfX + sizes[i].x);
+        pageSizes[page].y = std::max(pageSizes[page].y, shelfY + sizes[i].y);
+
+        shelfX += width;
+        shelfHeight = std::max(shelfHeight, height);
+    }
+
+    return regions;
+}
+
+std::vector<TextureLoader::Surface> TextureLoader::Compose(const std::vector<Surface>& surfaces, int32_t maxWidth, int32_t maxHeight, std::vector<int32_t>& pages, std::vector<SDL_Rect>& regions)
+{
+    std::vector<SDL_Point> sizes;
+
+    for (size_t i = 0; i < surfaces.size(); ++i)
+        sizes.push_back({ surfaces[i]->w, surfaces[i]->h });
+
+    std::vector<SDL_Point> pageSizes;
+    regions = Pack(sizes, maxWidth, maxHeight, pages, pageSizes);
+
+    std::vector<Surface> composed;
+
+    for (size_t i = 0; i < pageSizes.size(); ++i)
+    {
+        composed.emplace_back(SDL_CreateRGBSurfaceWithFormat(0, pageSizes[i].x, pageSizes[i].y, 32, SDL_PIXELFORMAT_ARGB8888), SDL_FreeSurface);
+
+        if (!composed.back())
+            throw TextureLoaderException("Creating texture atlas has failed!");
+
+        for (size_t j = 0; j < surfaces.size(); ++j)
+        {
+            if (pages[j] != (int32_t)i)
+                continue;
+
+            SDL_Rect region = regions[j];
+            SDL_SetSurfaceBlendMode(surfaces[j].get(), SDL_BLENDMODE_NONE); // copy alpha as is
+
+            if (SDL_BlitSurface(surfaces[j].get(), nullptr, composed.back().get(), &region) != 0)
+                throw TextureLoaderException("Packing texture into atlas has failed!");
+        }
+    }
+
+    return composed;
+}
+
+std::vector<TextureLoader::Surface> TextureLoader::Decode(const std::vector<std::string>& paths)
+{
+    std::vector<Surface> surfaces;
+    std::vector<std::string> errors(paths.size());
+
+    for (size_t i = 0; i < paths.size(); ++i)
+        surfaces.emplace_back(nullptr, SDL_FreeSurface);
+
+    // initialize the decoder up front, lazy initialization inside of IMG_Load is not thread safe
+    IMG_Init(IMG_INIT_PNG);
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < paths.size(); i = next++)
+        {
+            Surface decoded(IMG_Load(paths[i].c_str()), SDL_FreeSurface);
+
+            if (decoded)
+                surfaces[i].reset(SDL_ConvertSurfaceFormat(decoded.get(), SDL_PIXELFORMAT_ARGB8888, 0));
+
+            if (!surfaces[i])
+                errors[i] = SDL_GetError(); // errors are thread local
+        }
+    };
+
+    size_t count = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), paths.size());
+    std::vector<std::thread> threads;
+
+    for (size_t i = 1; i < count; ++i)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        if (!surfaces[i])
+            throw TextureLoaderException("Loading texture " + paths[i] + " has failed!", errors[i]);
+    }
+
+    return surfaces;
+}
+
+bool TextureLoader::HashSource(const std::string& path, uint64_t& hash)
+{
+    MappedFile file(path);
+
+    if (!file.IsOpen())
+        return false;
+
+    // FNV-1a over 8 byte words
+    const uint8_t* data = file.GetData();
+    size_t size = file.GetSize();
+    size_t i = 0;
+    hash = FNV_OFFSET;
+
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+
+    for (; i < size; ++i)
+        hash = (hash ^ data[i]) * FNV_PRIME;
+
+    hash = (hash ^ size) * FNV_PRIME;
+    return true;
 }
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <SDL2/SDL_image.h>
+#include <cstdint>
 #include <string>
 #include <memory>
+#include <vector>
+#include <unordered_map>
 
 /**
  * @brief Class used for wrapping exception context from the TextureLoader class.
@@ -19,6 +22,12 @@ public:
      * @param message Programmer given context.
     */
     inline TextureLoaderException(const std::string& message) : _sdl(SDL_GetError()), _message(message) { }
+    /**
+     * @brief Create a new instance of the object.
+     * @param message Programmer given context.
+     * @param sdl SDL error captured on other thread.
+    */
+    inline TextureLoaderException(const std::string& message, const std::string& sdl) : _sdl(sdl), _message(message) { }
     /**
      * @brief Message getter.
      * @return Exception context.
@@ -32,42 +41,151 @@ public:
 };
 
 /**
- * @brief Class used for storing texture. Wrapper around the SDL_Texture.
+ * @brief Class used for storing texture. Wrapper around a region of the shared SDL_Texture.
 */
 class Texture
 {
 private:
-    SDL_Texture* _texture;
+    std::shared_ptr<SDL_Texture> _texture;
+    SDL_Rect _source;
 
 public:
     /**
-     * @brief Create a new instance of the object.
-     * @param texture Pointer to the allocated texture.
+     * @brief Create a new instance of the object covering the whole texture.
+     * @param texture Pointer to the allocated texture. Ownership is taken.
     */
     Texture(SDL_Texture* texture);
     /**
-     * @brief Free loaded SDL_Texture before destroying a instance of the object.
-     */
-    ~Texture();
+     * @brief Create a new instance of the object covering a region of the texture atlas.
+     * @param atlas Shared texture atlas.
+     * @param source Region of the atlas.
+    */
+    Texture(const std::shared_ptr<SDL_Texture>& atlas, const SDL_Rect& source);
 
     /**
      * @brief Texture getter.
      * @return Pointer to the loaded texture.
     */
     SDL_Texture* GetTexture() const;
+    /**
+     * @brief Source region getter.
+     * @return Region of the texture.
+    */
+    const SDL_Rect& GetSource() const;
 };
 
 /**
- * @brief Class used for loading the Texture objects.
+ * @brief Handle of a texture registered in the TextureRegistry class, 0 is no texture.
+*/
+typedef uint32_t TextureHandle;
+
+/**
+ * @brief Class used for owning the Texture objects referenced by handles. Handles stay valid until the registry is cleared.
+*/
+class TextureRegistry
+{
+private:
+    std::vector<std::shared_ptr<Texture>> _textures; // the first slot is no texture
+
+public:
+    /**
+     * @brief Create a new instance of the object with no registered textures.
+    */
+    TextureRegistry();
+
+    /**
+     * @brief Register a texture.
+     * @param texture Smart pointer to the Texture object.
+     * @return Handle of the texture.
+    */
+    TextureHandle Add(const std::shared_ptr<Texture>& texture);
+    /**
+     * @brief Resolve a handle.
+     * @param handle Handle of the texture.
+     * @return Pointer to the Texture object, null pointer for no texture or an unknown handle.
+    */
+    inline const Texture* Get(TextureHandle handle) const { return handle < _textures.size() ? _textures[handle].get() : nullptr; }
+    /**
+     * @brief Release all the registered textures, the handles become unknown.
+    */
+    void Clear();
+};
+
+/**
+ * @brief Class used for loading the Texture objects. Files are decoded on worker threads and loaded textures are cached by path.
 */
 class TextureLoader
 {
+private:
+    static const int32_t ATLAS_MAX_SIZE = 4096;
+    static const int32_t ATLAS_PADDING = 1;
+
+    typedef std::unique_ptr<SDL_Surface, void(*)(SDL_Surface*)> Surface;
+
+    std::unordered_map<std::string, std::shared_ptr<Texture>> _cache;
+
 public:
     /**
-     * @brief Load texture from the file.
+     * @brief Load texture from the file. Repeated requests return the cached texture.
      * @param path File path.
-     * @param renderer Renderer to load the texture.
+     * @param renderer Renderer to load the texture. Null renderer results in empty texture without decoding the file.
      * @return Smart pointer to the Texture object.
     */
-    static std::shared_ptr<Texture> Load(const std::string& path, SDL_Renderer* renderer);
+    std::shared_ptr<Texture> Load(const std::string& path, SDL_Renderer* renderer);
+    /**
+     * @brief Load textures from the files packed into as few texture atlases as possible. Repeated requests return the cached textures.
+     * @param paths File paths.
+     * @param renderer Renderer to load the textures. Null renderer results in empty textures without decoding the files.
+     * @return Smart pointers to the Texture objects in order of the paths.
+    */
+    std::vector<std::shared_ptr<Texture>> LoadAtlas(const std::vector<std::string>& paths, SDL_Renderer* renderer);
+    /**
+     * @brief Load textures from the prebaked asset pack. The pack is memory mapped and the pixels are uploaded as they are.
+     * Sprites whose source file changed since baking are skipped and decoded from the file on request.
+     * @param path Asset pack file path.
+     * @param renderer Renderer to load the textures.
+     * @return True if the pack was loaded, false if it is missing or not usable with the renderer.
+    */
+    bool LoadPack(const std::string& path, SDL_Renderer* renderer);
+    /**
+     * @brief Bake the files into the asset pack of decoded texture atlases. The hash of every source file is stored with its sprite.
+     * @param paths File paths.
+     * @param output Asset pack file path.
+    */
+    static void Bake(const std::vector<std::string>& paths, const std::string& output);
+    /**
+     * @brief Pack rectangles into pages using shelf packing. Rectangles larger than a page get a page of their own.
+     * @param sizes Sizes of the rectangles.
+     * @param pageWidth Page width.
+     * @param pageHeight Page height.
+     * @param pages Resulting page of each rectangle.
+     * @param pageSizes Resulting used size of each page.
+     * @return Position of each rectangle inside of its page.
+    */
+    static std::vector<SDL_Rect> Pack(const std::vector<SDL_Point>& sizes, int32_t pageWidth, int32_t pageHeight, std::vector<int32_t>& pages, std::vector<SDL_Point>& pageSizes);
+
+private:
+    /**
+     * @brief Pack the surfaces and compose them into texture atlas pages.
+     * @param surfaces Surfaces to pack.
+     * @param maxWidth Maximal page width.
+     * @param maxHeight Maximal page height.
+     * @param pages Resulting page of each surface.
+     * @param regions Resulting region of each surface.
+     * @return Composed pages.
+    */
+    static std::vector<Surface> Compose(const std::vector<Surface>& surfaces, int32_t maxWidth, int32_t maxHeight, std::vector<int32_t>& pages, std::vector<SDL_Rect>& regions);
+    /**
+     * @brief Decode the files into surfaces in the 32-bit ARGB format on a pool of worker threads.
+     * @param paths File paths.
+     * @return Decoded surfaces in order of the paths.
+    */
+    static std::vector<Surface> Decode(const std::vector<std::string>& paths);
+    /**
+     * @brief Hash the content of a source file.
+     * @param path File path.
+     * @param hash Output hash of the content.
+     * @return False if the file can't be read.
+    */
+    static bool HashSource(const std::string& path, uint64_t& hash);
 };
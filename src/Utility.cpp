@@ -1 +1,62 @@
 #include "Utility.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile(const std::string& path)
+    : _open(false), _data(nullptr), _size(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return;
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return;
+    }
+
+    // empty file can't be mapped
+    if (info.st_size == 0)
+        _open = true;
+
+    if (info.st_size > 0)
+    {
+        void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data != MAP_FAILED)
+        {
+            _open = true;
+            _data = (const uint8_t*)data;
+            _size = (size_t)info.st_size;
+        }
+    }
+
+    close(fd); // the mapping outlives the descriptor
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data != nullptr)
+        munmap((void*)_data, _size);
+}
+
+bool MappedFile::IsOpen() const
+{
+    return _open;
+}
+
+const uint8_t* MappedFile::GetData() const
+{
+    return _data;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return _size;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
+#include <string>
 
 /**
  * @brief Structure used for storing color data.
@@ -12,3 +14,43 @@ struct Color
     uint8_t B;
     uint8_t A;
 };
+
+/**
+ * @brief Class used for read-only memory mapping of a file.
+*/
+class MappedFile
+{
+private:
+    bool _open;
+    const uint8_t* _data;
+    size_t _size;
+
+public:
+    /**
+     * @brief Create a new instance of the object and map the file.
+     * @param path File path.
+    */
+    MappedFile(const std::string& path);
+    /**
+     * @brief Unmap the file before destroying a instance of the object.
+    */
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Open flag getter.
+     * @return True if the file was mapped.
+    */
+    bool IsOpen() const;
+    /**
+     * @brief Data getter.
+     * @return Pointer to the mapped data, null pointer for empty file.
+    */
+    const uint8_t* GetData() const;
+    /**
+     * @brief Size getter.
+     * @return Size of the mapped data in bytes.
+    */
+    size_t GetSize() const;
+};